@@ -0,0 +1,164 @@
+/********************************************************
+  Host HAL - Print, String, Serial and ESP helpers
+******************************************************/
+
+#include <stdarg.h>
+#include <time.h>
+#include "Arduino.h"
+#include "hal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+HardwareSerial Serial;
+EspClass ESP;
+
+namespace
+{
+  bool serialEnabled = true;
+
+  std::string formatNumber(unsigned long value, int base)
+  {
+    if (base < 2)
+      base = 10;
+    char digits[8 * sizeof(long) + 1];
+    char *p = &digits[sizeof(digits) - 1];
+    *p = '\0';
+    do
+    {
+      int digit = value % base;
+      *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+      value /= base;
+    } while (value);
+    return std::string(p);
+  }
+
+  std::string formatFloat(double value, int digits)
+  {
+    char text[48];
+    if (isnan(value))
+      return "nan";
+    if (isinf(value))
+      return "inf";
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return std::string(text);
+  }
+}
+
+namespace hal
+{
+  void setSerialEnabled(bool enabled)
+  {
+    serialEnabled = enabled;
+  }
+}
+
+/********************************************************
+  String
+******************************************************/
+String::String(int value, unsigned char base) : String((long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+String::String(long value, unsigned char base)
+    : s(value < 0 && base == 10 ? "-" + formatNumber(-(unsigned long)value, base) : formatNumber(value, base)) {}
+String::String(unsigned long value, unsigned char base) : s(formatNumber(value, base)) {}
+String::String(float value, unsigned char decimalPlaces) : s(formatFloat(value, decimalPlaces)) {}
+String::String(double value, unsigned char decimalPlaces) : s(formatFloat(value, decimalPlaces)) {}
+
+/********************************************************
+  Print
+******************************************************/
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+    n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(long value, int base)
+{
+  if (value < 0 && (base == DEC || base < 2))
+    return print('-') + write(formatNumber(-(unsigned long)value, base).c_str());
+  return write(formatNumber(value, base).c_str());
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  return write(formatNumber(value, base).c_str());
+}
+
+size_t Print::print(double value, int digits)
+{
+  return write(formatFloat(value, digits).c_str());
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char text[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (length < 0)
+    return 0;
+  return write((const uint8_t *)text, std::min<size_t>(length, sizeof(text) - 1));
+}
+
+/********************************************************
+  Serial goes to stdout
+******************************************************/
+size_t HardwareSerial::write(uint8_t c)
+{
+  if (serialEnabled)
+    fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  if (serialEnabled)
+    fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+/********************************************************
+  ESP
+******************************************************/
+uint32_t EspClass::getFreeHeap()
+{
+  return 200000;
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+  return 200000;
+}
+
+// host cycles, only meaningful for relative measurements
+uint32_t EspClass::getCycleCount()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return (uint32_t)__rdtsc();
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+void EspClass::restart()
+{
+  fflush(stdout);
+  exit(0);
+}
+
+long random(long max)
+{
+  return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max)
+{
+  return max > min ? min + random(max - min) : min;
+}
@@ -0,0 +1,42 @@
+/********************************************************
+  Host HAL - ArduinoOTA shim (updates are never offered)
+******************************************************/
+
+#ifndef _ArduinoOTA_H
+#define _ArduinoOTA_H
+
+#include <functional>
+#include "Arduino.h"
+#include "WiFi.h"
+
+typedef enum
+{
+  OTA_AUTH_ERROR,
+  OTA_BEGIN_ERROR,
+  OTA_CONNECT_ERROR,
+  OTA_RECEIVE_ERROR,
+  OTA_END_ERROR
+} ota_error_t;
+
+class ArduinoOTAClass
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+  typedef std::function<void(ota_error_t)> THandlerFunction_Error;
+
+  ArduinoOTAClass &setHostname(const char *hostname) { (void)hostname; return *this; }
+  ArduinoOTAClass &setPassword(const char *password) { (void)password; return *this; }
+  ArduinoOTAClass &onStart(THandlerFunction fn) { startHandler = fn; return *this; }
+  ArduinoOTAClass &onEnd(THandlerFunction fn) { endHandler = fn; return *this; }
+  ArduinoOTAClass &onError(THandlerFunction_Error fn) { errorHandler = fn; return *this; }
+  void begin() {}
+  void handle() {}
+
+private:
+  THandlerFunction startHandler, endHandler;
+  THandlerFunction_Error errorHandler;
+};
+
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif // _ArduinoOTA_H
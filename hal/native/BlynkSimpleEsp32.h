@@ -0,0 +1,131 @@
+/********************************************************
+  Host HAL - Blynk shim
+  Virtual pins set with hal::blynkAppWrite() reach the
+  BLYNK_WRITE handlers on Blynk.run() and Blynk.syncVirtual().
+******************************************************/
+
+#ifndef _BlynkSimpleEsp32_H
+#define _BlynkSimpleEsp32_H
+
+#include "Arduino.h"
+#include "WiFi.h"
+
+class BlynkParam
+{
+public:
+  explicit BlynkParam(double value) : value(value) {}
+  int asInt() const { return (int)value; }
+  long asLong() const { return (long)value; }
+  float asFloat() const { return (float)value; }
+  double asDouble() const { return value; }
+
+private:
+  double value;
+};
+
+struct BlynkReq
+{
+  uint8_t pin;
+};
+
+#define BLYNK_UNUSED __attribute__((__unused__)) // as in BlynkApi.h, handlers rarely use both
+#define BLYNK_WRITE(pin) BLYNK_WRITE_2(pin)
+#define BLYNK_WRITE_2(pin) void BlynkWidgetWrite##pin(BlynkReq BLYNK_UNUSED &request, const BlynkParam BLYNK_UNUSED &param)
+#define BLYNK_CONNECTED() void BlynkOnConnected()
+
+void BlynkOnConnected();
+
+class BlynkClass
+{
+public:
+  void config(const char *auth, const char *domain, uint16_t port)
+  {
+    (void)auth;
+    (void)domain;
+    (void)port;
+  }
+  bool connect(unsigned long timeout = 30000);
+  bool connected();
+  void run();
+  void syncAll();
+  void syncVirtual(int pin);
+
+  template <typename... Args>
+  void virtualWrite(int pin, Args... values)
+  {
+    double list[] = {(double)values...};
+    virtualWriteValues(pin, list, sizeof...(values));
+  }
+
+private:
+  void virtualWriteValues(int pin, const double *values, size_t count);
+};
+
+extern BlynkClass Blynk;
+
+#define V0 0
+#define V1 1
+#define V2 2
+#define V3 3
+#define V4 4
+#define V5 5
+#define V6 6
+#define V7 7
+#define V8 8
+#define V9 9
+#define V10 10
+#define V11 11
+#define V12 12
+#define V13 13
+#define V14 14
+#define V15 15
+#define V16 16
+#define V17 17
+#define V18 18
+#define V19 19
+#define V20 20
+#define V21 21
+#define V22 22
+#define V23 23
+#define V24 24
+#define V25 25
+#define V26 26
+#define V27 27
+#define V28 28
+#define V29 29
+#define V30 30
+#define V31 31
+#define V32 32
+#define V33 33
+#define V34 34
+#define V35 35
+#define V36 36
+#define V37 37
+#define V38 38
+#define V39 39
+#define V40 40
+#define V41 41
+#define V42 42
+#define V43 43
+#define V44 44
+#define V45 45
+#define V46 46
+#define V47 47
+#define V48 48
+#define V49 49
+#define V50 50
+#define V51 51
+#define V52 52
+#define V53 53
+#define V54 54
+#define V55 55
+#define V56 56
+#define V57 57
+#define V58 58
+#define V59 59
+#define V60 60
+#define V61 61
+#define V62 62
+#define V63 63
+
+#endif // _BlynkSimpleEsp32_H
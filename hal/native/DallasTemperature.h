@@ -0,0 +1,45 @@
+/********************************************************
+  Host HAL - DallasTemperature shim, reads hal::temperature()
+******************************************************/
+
+#ifndef _DallasTemperature_H
+#define _DallasTemperature_H
+
+#include "Arduino.h"
+#include "OneWire.h"
+#include "hal.h"
+
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature
+{
+public:
+  explicit DallasTemperature(OneWire *oneWire) : oneWire(oneWire) {}
+  void begin() {}
+  bool getAddress(uint8_t *address, uint8_t index)
+  {
+    memset(address, 0, 8);
+    address[0] = 0x28;
+    address[7] = index;
+    return true;
+  }
+  bool setResolution(const uint8_t *address, uint8_t resolution)
+  {
+    (void)address;
+    this->resolution = resolution;
+    return true;
+  }
+  void requestTemperatures() { hal::busyWait(750000UL >> (12 - resolution)); }
+  float getTempCByIndex(uint8_t index)
+  {
+    (void)index;
+    float step = 0.0625f * (1 << (12 - resolution));
+    return floorf(hal::temperature() / step) * step;
+  }
+
+private:
+  OneWire *oneWire;
+  uint8_t resolution = 12;
+};
+
+#endif // _DallasTemperature_H
@@ -0,0 +1,44 @@
+/********************************************************
+  Host HAL - EEPROM emulation (optionally backed by a file)
+******************************************************/
+
+#ifndef _EEPROM_H
+#define _EEPROM_H
+
+#include "Arduino.h"
+
+class EEPROMClass
+{
+public:
+  static const size_t capacity = 4096;
+
+  bool begin(size_t size);
+  bool commit();
+  void end() { commit(); }
+  uint8_t read(int address) { return data[address]; }
+  void write(int address, uint8_t value) { data[address] = value; }
+  size_t length() { return size; }
+
+  template <typename T>
+  T &get(int address, T &t)
+  {
+    memcpy((uint8_t *)&t, data + address, sizeof(T));
+    return t;
+  }
+
+  template <typename T>
+  const T &put(int address, const T &t)
+  {
+    memcpy(data + address, (const uint8_t *)&t, sizeof(T));
+    return t;
+  }
+
+private:
+  uint8_t data[capacity];
+  size_t size = 0;
+  bool loaded = false;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // _EEPROM_H
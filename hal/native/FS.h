@@ -0,0 +1,50 @@
+/********************************************************
+  Host HAL - Arduino FS shim (File and FS of the ESP32 core)
+  Files live in the directory set with hal::setFlashDirectory().
+******************************************************/
+
+#ifndef _FS_H
+#define _FS_H
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs
+{
+  class File
+  {
+  public:
+    File(FILE *file = nullptr) : file(file) {}
+
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write(uint8_t value) { return write(&value, 1); }
+    size_t read(uint8_t *buffer, size_t size);
+    int read();
+    size_t size() const;
+    void close();
+    operator bool() const { return file != nullptr; }
+
+  private:
+    FILE *file;
+  };
+
+  class FS
+  {
+  public:
+    File open(const char *path, const char *mode = FILE_READ);
+    bool exists(const char *path);
+    bool remove(const char *path);
+    bool rename(const char *pathFrom, const char *pathTo);
+
+  protected:
+    bool mounted = false;
+  };
+}
+
+using fs::File;
+using fs::FS;
+
+#endif // _FS_H
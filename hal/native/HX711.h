@@ -0,0 +1,40 @@
+/********************************************************
+  Host HAL - bogde HX711 shim
+  Conversions complete at the rate set with hal::setLoadCellRate()
+  (before begin()); reading before a conversion is ready blocks
+  like the real chip. DOUT signals data ready, so FALLING edge
+  interrupts on it work.
+******************************************************/
+
+#ifndef _HX711_H
+#define _HX711_H
+
+#include "Arduino.h"
+
+class HX711
+{
+public:
+  void begin(byte dout, byte pd_sck, byte gain = 128);
+  bool is_ready();
+  void wait_ready(unsigned long delay_ms = 0);
+  long read();
+  long read_average(byte times = 10);
+  double get_value(byte times = 1) { return read_average(times) - offset; }
+  float get_units(byte times = 1) { return get_value(times) / scale; }
+  void tare(byte times = 10) { set_offset(read_average(times)); }
+  void set_scale(float scale = 1.f) { this->scale = scale; }
+  float get_scale() { return scale; }
+  void set_offset(long offset = 0) { this->offset = offset; }
+  long get_offset() { return offset; }
+  void power_down() {}
+  void power_up() {}
+
+private:
+  byte dout = 0;
+  byte sck = 0;
+  long offset = 0;
+  float scale = 1.f;
+  uint64_t lastConversion = 0;
+};
+
+#endif // _HX711_H
@@ -0,0 +1,37 @@
+/********************************************************
+  Host HAL - 256dpi MQTT client shim
+******************************************************/
+
+#ifndef _MQTT_H
+#define _MQTT_H
+
+#include "Arduino.h"
+#include "WiFi.h"
+
+class MQTTClient;
+typedef void (*MQTTClientCallbackSimple)(String &topic, String &payload);
+typedef void (*MQTTClientCallbackAdvanced)(MQTTClient *client, char topic[], char bytes[], int length);
+
+class MQTTClient
+{
+public:
+  void begin(const char *hostname, WiFiClient &client)
+  {
+    (void)hostname;
+    (void)client;
+  }
+  bool connect(const char *clientId, const char *username = nullptr, const char *password = nullptr);
+  bool connected();
+  bool loop();
+  bool subscribe(const char *topic);
+  void onMessage(MQTTClientCallbackSimple callback) { this->callback = callback; }
+  void onMessageAdvanced(MQTTClientCallbackAdvanced callback) { advancedCallback = callback; }
+  bool publish(const char *topic, const char *payload);
+  bool publish(const char *topic, const String &payload) { return publish(topic, payload.c_str()); }
+
+private:
+  MQTTClientCallbackSimple callback = nullptr;
+  MQTTClientCallbackAdvanced advancedCallback = nullptr;
+};
+
+#endif // _MQTT_H
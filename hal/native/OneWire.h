@@ -0,0 +1,19 @@
+/********************************************************
+  Host HAL - OneWire shim
+******************************************************/
+
+#ifndef _OneWire_H
+#define _OneWire_H
+
+#include "Arduino.h"
+
+class OneWire
+{
+public:
+  explicit OneWire(uint8_t pin) : pin(pin) {}
+
+private:
+  uint8_t pin;
+};
+
+#endif // _OneWire_H
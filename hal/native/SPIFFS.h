@@ -0,0 +1,20 @@
+/********************************************************
+  Host HAL - SPIFFS shim, mounts only if a flash directory
+  was set with hal::setFlashDirectory()
+******************************************************/
+
+#ifndef _SPIFFS_H
+#define _SPIFFS_H
+
+#include "FS.h"
+
+class SPIFFSFS : public fs::FS
+{
+public:
+  bool begin(bool formatOnFail = false);
+  void end() { mounted = false; }
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif // _SPIFFS_H
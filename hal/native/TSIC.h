@@ -0,0 +1,32 @@
+/********************************************************
+  Host HAL - TSIC 306 shim, reads hal::temperature()
+******************************************************/
+
+#ifndef _TSIC_H
+#define _TSIC_H
+
+#include "Arduino.h"
+#include "hal.h"
+
+class TSIC
+{
+public:
+  explicit TSIC(uint8_t signalPin, uint8_t vccPin = 255) : signalPin(signalPin), vccPin(vccPin) {}
+
+  // TSIC 306: 11 bit over -50 ... 150 °C
+  uint8_t getTemperature(uint16_t *temperature)
+  {
+    float celsius = hal::temperature();
+    if (celsius < -50 || celsius > 150)
+      return 0;
+    *temperature = (uint16_t)((celsius + 50.0f) * 2047.0f / 200.0f + 0.5f);
+    return 1;
+  }
+  float calc_Celsius(uint16_t *temperature) { return ((float)*temperature * 200.0f / 2047.0f) - 50.0f; }
+
+private:
+  uint8_t signalPin;
+  uint8_t vccPin;
+};
+
+#endif // _TSIC_H
@@ -0,0 +1,128 @@
+/********************************************************
+  Host HAL - U8g2 shim
+  Keeps a real 128x64 frame buffer in u8g2 page layout
+  (one byte = 8 vertical pixels, 16 tiles per page) so
+  drawing code and bus traffic can be inspected on the host.
+  Text uses placeholder glyphs of the selected font size.
+******************************************************/
+
+#ifndef _U8g2lib_H
+#define _U8g2lib_H
+
+#include "Arduino.h"
+
+#define U8X8_PIN_NONE 255
+
+typedef struct
+{
+  uint8_t rotation;
+} u8g2_cb_t;
+
+extern const u8g2_cb_t u8g2_cb_r0, u8g2_cb_r1, u8g2_cb_r2, u8g2_cb_r3;
+#define U8G2_R0 (&u8g2_cb_r0)
+#define U8G2_R1 (&u8g2_cb_r1)
+#define U8G2_R2 (&u8g2_cb_r2)
+#define U8G2_R3 (&u8g2_cb_r3)
+
+// shim fonts only carry their glyph box: {width, height, ascent}
+extern const uint8_t u8g2_font_profont11_tf[];
+extern const uint8_t u8g2_font_6x12_tf[];
+extern const uint8_t u8g2_font_IPAandRUSLCD_tf[];
+extern const uint8_t u8g2_font_4x6_tf[];
+
+class U8G2 : public Print
+{
+public:
+  static const uint8_t width = 128;
+  static const uint8_t height = 64;
+
+  explicit U8G2(const u8g2_cb_t *rotation);
+
+  bool begin() { return true; }
+  void clearBuffer() { memset(buffer, 0, sizeof(buffer)); }
+  void sendBuffer();
+  void clearDisplay()
+  {
+    clearBuffer();
+    sendBuffer();
+  }
+  void updateDisplay() { sendBuffer(); }
+  void updateDisplayArea(uint8_t tx, uint8_t ty, uint8_t tw, uint8_t th);
+
+  uint8_t *getBufferPtr() { return buffer; }
+  uint8_t getBufferTileWidth() { return width / 8; }
+  uint8_t getBufferTileHeight() { return height / 8; }
+  uint8_t getDisplayWidth() { return width; }
+  uint8_t getDisplayHeight() { return height; }
+
+  void setFont(const uint8_t *font);
+  void setFontRefHeightExtendedText() {}
+  void setFontPosTop() { posTop = true; }
+  void setFontPosBaseline() { posTop = false; }
+  void setFontDirection(uint8_t direction) { (void)direction; }
+  void setDisplayRotation(const u8g2_cb_t *rotation) { this->rotation = rotation; }
+  void setDrawColor(uint8_t color) { drawColor = color; }
+  void setBitmapMode(uint8_t mode) { bitmapTransparent = mode != 0; }
+  void setCursor(int16_t x, int16_t y)
+  {
+    cursorX = x;
+    cursorY = y;
+  }
+  uint16_t getStrWidth(const char *s) { return strlen(s) * fontWidth; }
+  int8_t getMaxCharHeight() { return fontHeight; }
+
+  void drawPixel(int16_t x, int16_t y);
+  void drawHLine(int16_t x, int16_t y, int16_t w);
+  void drawVLine(int16_t x, int16_t y, int16_t h);
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+  void drawFrame(int16_t x, int16_t y, int16_t w, int16_t h);
+  void drawBox(int16_t x, int16_t y, int16_t w, int16_t h);
+  void drawXBMP(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *bitmap);
+  uint16_t drawStr(int16_t x, int16_t y, const char *s);
+  uint16_t drawGlyph(int16_t x, int16_t y, uint16_t encoding);
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+private:
+  void setPixel(int16_t x, int16_t y, uint8_t color);
+
+  uint8_t buffer[width * height / 8];
+  const u8g2_cb_t *rotation;
+  uint8_t drawColor = 1;
+  bool bitmapTransparent = false;
+  bool posTop = false;
+  uint8_t fontWidth = 6;
+  uint8_t fontHeight = 11;
+  uint8_t fontAscent = 8;
+  int16_t cursorX = 0;
+  int16_t cursorY = 0;
+};
+
+class U8G2_SSD1306_128X64_NONAME_F_HW_I2C : public U8G2
+{
+public:
+  U8G2_SSD1306_128X64_NONAME_F_HW_I2C(const u8g2_cb_t *rotation, uint8_t reset = U8X8_PIN_NONE,
+                                      uint8_t clock = U8X8_PIN_NONE, uint8_t data = U8X8_PIN_NONE)
+      : U8G2(rotation)
+  {
+    (void)reset;
+    (void)clock;
+    (void)data;
+  }
+};
+
+class U8G2_SH1106_128X64_NONAME_F_HW_I2C : public U8G2
+{
+public:
+  U8G2_SH1106_128X64_NONAME_F_HW_I2C(const u8g2_cb_t *rotation, uint8_t reset = U8X8_PIN_NONE,
+                                     uint8_t clock = U8X8_PIN_NONE, uint8_t data = U8X8_PIN_NONE)
+      : U8G2(rotation)
+  {
+    (void)reset;
+    (void)clock;
+    (void)data;
+  }
+};
+
+#endif // _U8g2lib_H
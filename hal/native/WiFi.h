@@ -0,0 +1,53 @@
+/********************************************************
+  Host HAL - WiFi shim, link state is set with hal::setWifiConnected()
+******************************************************/
+
+#ifndef _WiFi_H
+#define _WiFi_H
+
+#include "Arduino.h"
+
+typedef enum
+{
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} wifi_mode_t;
+
+class IPAddress
+{
+public:
+  operator String() const { return String("127.0.0.1"); }
+};
+
+class WiFiClass
+{
+public:
+  bool setHostname(const char *hostname) { (void)hostname; return true; }
+  bool mode(wifi_mode_t mode) { (void)mode; return true; }
+  void persistent(bool persistent) { (void)persistent; }
+  wl_status_t begin(const char *ssid, const char *pass) { (void)ssid; (void)pass; return status(); }
+  bool disconnect(bool wifioff = false) { (void)wifioff; return true; }
+  wl_status_t status();
+  int8_t RSSI() { return -60; }
+  IPAddress localIP() { return IPAddress(); }
+};
+
+class WiFiClient
+{
+};
+
+extern WiFiClass WiFi;
+
+#endif // _WiFi_H
@@ -0,0 +1,667 @@
+/********************************************************
+  Host HAL - peripherals: temperature sensors, EEPROM,
+  SPIFFS, display, WiFi, Blynk, MQTT, HX711 and OTA
+******************************************************/
+
+#include <map>
+#include <vector>
+#include "Arduino.h"
+#include "ArduinoOTA.h"
+#include "BlynkSimpleEsp32.h"
+#include "EEPROM.h"
+#include "HX711.h"
+#include "MQTT.h"
+#include "SPIFFS.h"
+#include "U8g2lib.h"
+#include "WiFi.h"
+#include "hal.h"
+#include "halInternal.h"
+
+EEPROMClass EEPROM;
+SPIFFSFS SPIFFS;
+WiFiClass WiFi;
+BlynkClass Blynk;
+ArduinoOTAClass ArduinoOTA;
+
+namespace
+{
+  float fixedTemperature = 20.0f;
+  hal::TemperatureSource temperatureSource = nullptr;
+  void *temperatureContext = nullptr;
+
+  hal::LoadCellSource loadCellSource = nullptr;
+  void *loadCellContext = nullptr;
+  uint32_t loadCellRate = 10;
+
+  std::string eepromFile;
+  std::string flashDirectory;
+
+  bool wifiConnected = true;
+  bool blynkConnected = true;
+  std::map<int, double> blynkAppValues;
+  std::vector<int> blynkPending;
+  std::map<int, double> blynkDeviceValues;
+
+  bool mqttConnected = false;
+  std::vector<std::pair<String, String>> mqttPending;
+
+  U8G2 *display = nullptr;
+  uint8_t panel[U8G2::width * U8G2::height / 8]; // what the display shows, written by updateDisplayArea()
+  const uint64_t i2cByteUs = 23; // 9 clocks per byte at 400 kHz
+}
+
+namespace hal
+{
+  void setTemperature(float celsius)
+  {
+    fixedTemperature = celsius;
+    temperatureSource = nullptr;
+  }
+
+  void setTemperatureSource(TemperatureSource source, void *context)
+  {
+    temperatureSource = source;
+    temperatureContext = context;
+  }
+
+  float temperature()
+  {
+    return temperatureSource ? temperatureSource(temperatureContext) : fixedTemperature;
+  }
+
+  void setLoadCellSource(LoadCellSource source, void *context)
+  {
+    loadCellSource = source;
+    loadCellContext = context;
+  }
+
+  void setLoadCellRate(uint32_t samplesPerSecond)
+  {
+    loadCellRate = samplesPerSecond ? samplesPerSecond : 10;
+  }
+
+  void setEepromFile(const char *path)
+  {
+    eepromFile = path ? path : "";
+  }
+
+  void setFlashDirectory(const char *path)
+  {
+    flashDirectory = path ? path : "";
+  }
+
+  void setWifiConnected(bool connected)
+  {
+    wifiConnected = connected;
+  }
+
+  void setBlynkConnected(bool connected)
+  {
+    blynkConnected = connected;
+  }
+
+  void blynkAppWrite(int pin, double value)
+  {
+    blynkAppValues[pin] = value;
+    blynkPending.push_back(pin);
+  }
+
+  double blynkLastWrite(int pin)
+  {
+    std::map<int, double>::const_iterator it = blynkDeviceValues.find(pin);
+    return it == blynkDeviceValues.end() ? NAN : it->second;
+  }
+
+  void setMqttConnected(bool connected)
+  {
+    mqttConnected = connected;
+  }
+
+  void mqttPublishToDevice(const char *topic, const char *payload)
+  {
+    mqttPending.push_back(std::make_pair(String(topic), String(payload)));
+  }
+
+  const uint8_t *displayBuffer()
+  {
+    return display ? panel : nullptr;
+  }
+}
+
+/********************************************************
+  EEPROM
+******************************************************/
+bool EEPROMClass::begin(size_t size)
+{
+  this->size = std::min(size, capacity);
+  if (!loaded)
+  {
+    memset(data, 0xff, sizeof(data)); // erased flash
+    if (!eepromFile.empty())
+    {
+      FILE *file = fopen(eepromFile.c_str(), "rb");
+      if (file)
+      {
+        size_t n = fread(data, 1, sizeof(data), file);
+        (void)n;
+        fclose(file);
+      }
+    }
+    loaded = true;
+  }
+  return true;
+}
+
+bool EEPROMClass::commit()
+{
+  if (eepromFile.empty())
+    return true;
+  FILE *file = fopen(eepromFile.c_str(), "wb");
+  if (!file)
+    return false;
+  fwrite(data, 1, sizeof(data), file);
+  fclose(file);
+  return true;
+}
+
+/********************************************************
+  SPIFFS, a file per file in the flash directory
+******************************************************/
+namespace
+{
+  std::string flashPath(const char *path)
+  {
+    return flashDirectory + (path[0] == '/' ? "" : "/") + path;
+  }
+}
+
+size_t fs::File::write(const uint8_t *buffer, size_t size)
+{
+  if (!file)
+    return 0;
+  size_t written = fwrite(buffer, 1, size, file);
+  hal::mutableStats().flashBytes += written;
+  return written;
+}
+
+size_t fs::File::read(uint8_t *buffer, size_t size)
+{
+  return file ? fread(buffer, 1, size, file) : 0;
+}
+
+int fs::File::read()
+{
+  return file ? fgetc(file) : -1;
+}
+
+size_t fs::File::size() const
+{
+  if (!file)
+    return 0;
+  long position = ftell(file);
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, position, SEEK_SET);
+  return size;
+}
+
+void fs::File::close()
+{
+  if (file)
+    fclose(file);
+  file = nullptr;
+}
+
+fs::File fs::FS::open(const char *path, const char *mode)
+{
+  if (!mounted)
+    return File();
+  char binaryMode[4] = {mode[0], 'b', 0, 0};
+  return File(fopen(flashPath(path).c_str(), binaryMode));
+}
+
+bool fs::FS::exists(const char *path)
+{
+  FILE *file = mounted ? fopen(flashPath(path).c_str(), "rb") : nullptr;
+  if (file)
+    fclose(file);
+  return file != nullptr;
+}
+
+bool fs::FS::remove(const char *path)
+{
+  return mounted && ::remove(flashPath(path).c_str()) == 0;
+}
+
+bool fs::FS::rename(const char *pathFrom, const char *pathTo)
+{
+  return mounted && ::rename(flashPath(pathFrom).c_str(), flashPath(pathTo).c_str()) == 0;
+}
+
+bool SPIFFSFS::begin(bool formatOnFail)
+{
+  (void)formatOnFail;
+  mounted = !flashDirectory.empty();
+  return mounted;
+}
+
+/********************************************************
+  WiFi
+******************************************************/
+wl_status_t WiFiClass::status()
+{
+  return wifiConnected ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+/********************************************************
+  Blynk
+******************************************************/
+#define BLYNK_DEFAULT_HANDLER(pin)                                                              \
+  void BlynkWidgetWrite##pin(BlynkReq &request, const BlynkParam &param) __attribute__((weak)); \
+  void BlynkWidgetWrite##pin(BlynkReq &request, const BlynkParam &param)                        \
+  {                                                                                             \
+    (void)request;                                                                              \
+    (void)param;                                                                                \
+  }
+
+BLYNK_DEFAULT_HANDLER(0)
+BLYNK_DEFAULT_HANDLER(1)
+BLYNK_DEFAULT_HANDLER(2)
+BLYNK_DEFAULT_HANDLER(3)
+BLYNK_DEFAULT_HANDLER(4)
+BLYNK_DEFAULT_HANDLER(5)
+BLYNK_DEFAULT_HANDLER(6)
+BLYNK_DEFAULT_HANDLER(7)
+BLYNK_DEFAULT_HANDLER(8)
+BLYNK_DEFAULT_HANDLER(9)
+BLYNK_DEFAULT_HANDLER(10)
+BLYNK_DEFAULT_HANDLER(11)
+BLYNK_DEFAULT_HANDLER(12)
+BLYNK_DEFAULT_HANDLER(13)
+BLYNK_DEFAULT_HANDLER(14)
+BLYNK_DEFAULT_HANDLER(15)
+BLYNK_DEFAULT_HANDLER(16)
+BLYNK_DEFAULT_HANDLER(17)
+BLYNK_DEFAULT_HANDLER(18)
+BLYNK_DEFAULT_HANDLER(19)
+BLYNK_DEFAULT_HANDLER(20)
+BLYNK_DEFAULT_HANDLER(21)
+BLYNK_DEFAULT_HANDLER(22)
+BLYNK_DEFAULT_HANDLER(23)
+BLYNK_DEFAULT_HANDLER(24)
+BLYNK_DEFAULT_HANDLER(25)
+BLYNK_DEFAULT_HANDLER(26)
+BLYNK_DEFAULT_HANDLER(27)
+BLYNK_DEFAULT_HANDLER(28)
+BLYNK_DEFAULT_HANDLER(29)
+BLYNK_DEFAULT_HANDLER(30)
+BLYNK_DEFAULT_HANDLER(31)
+BLYNK_DEFAULT_HANDLER(32)
+BLYNK_DEFAULT_HANDLER(33)
+BLYNK_DEFAULT_HANDLER(34)
+BLYNK_DEFAULT_HANDLER(35)
+BLYNK_DEFAULT_HANDLER(36)
+BLYNK_DEFAULT_HANDLER(37)
+BLYNK_DEFAULT_HANDLER(38)
+BLYNK_DEFAULT_HANDLER(39)
+BLYNK_DEFAULT_HANDLER(40)
+BLYNK_DEFAULT_HANDLER(41)
+BLYNK_DEFAULT_HANDLER(42)
+BLYNK_DEFAULT_HANDLER(43)
+BLYNK_DEFAULT_HANDLER(44)
+BLYNK_DEFAULT_HANDLER(45)
+BLYNK_DEFAULT_HANDLER(46)
+BLYNK_DEFAULT_HANDLER(47)
+BLYNK_DEFAULT_HANDLER(48)
+BLYNK_DEFAULT_HANDLER(49)
+BLYNK_DEFAULT_HANDLER(50)
+BLYNK_DEFAULT_HANDLER(51)
+BLYNK_DEFAULT_HANDLER(52)
+BLYNK_DEFAULT_HANDLER(53)
+BLYNK_DEFAULT_HANDLER(54)
+BLYNK_DEFAULT_HANDLER(55)
+BLYNK_DEFAULT_HANDLER(56)
+BLYNK_DEFAULT_HANDLER(57)
+BLYNK_DEFAULT_HANDLER(58)
+BLYNK_DEFAULT_HANDLER(59)
+BLYNK_DEFAULT_HANDLER(60)
+BLYNK_DEFAULT_HANDLER(61)
+BLYNK_DEFAULT_HANDLER(62)
+BLYNK_DEFAULT_HANDLER(63)
+
+void BlynkOnConnected() __attribute__((weak));
+void BlynkOnConnected() {}
+
+namespace
+{
+  typedef void (*BlynkHandler)(BlynkReq &request, const BlynkParam &param);
+  const BlynkHandler blynkHandlers[] = {
+    BlynkWidgetWrite0, BlynkWidgetWrite1, BlynkWidgetWrite2, BlynkWidgetWrite3, BlynkWidgetWrite4, BlynkWidgetWrite5, BlynkWidgetWrite6, BlynkWidgetWrite7,
+    BlynkWidgetWrite8, BlynkWidgetWrite9, BlynkWidgetWrite10, BlynkWidgetWrite11, BlynkWidgetWrite12, BlynkWidgetWrite13, BlynkWidgetWrite14, BlynkWidgetWrite15,
+    BlynkWidgetWrite16, BlynkWidgetWrite17, BlynkWidgetWrite18, BlynkWidgetWrite19, BlynkWidgetWrite20, BlynkWidgetWrite21, BlynkWidgetWrite22, BlynkWidgetWrite23,
+    BlynkWidgetWrite24, BlynkWidgetWrite25, BlynkWidgetWrite26, BlynkWidgetWrite27, BlynkWidgetWrite28, BlynkWidgetWrite29, BlynkWidgetWrite30, BlynkWidgetWrite31,
+    BlynkWidgetWrite32, BlynkWidgetWrite33, BlynkWidgetWrite34, BlynkWidgetWrite35, BlynkWidgetWrite36, BlynkWidgetWrite37, BlynkWidgetWrite38, BlynkWidgetWrite39,
+    BlynkWidgetWrite40, BlynkWidgetWrite41, BlynkWidgetWrite42, BlynkWidgetWrite43, BlynkWidgetWrite44, BlynkWidgetWrite45, BlynkWidgetWrite46, BlynkWidgetWrite47,
+    BlynkWidgetWrite48, BlynkWidgetWrite49, BlynkWidgetWrite50, BlynkWidgetWrite51, BlynkWidgetWrite52, BlynkWidgetWrite53, BlynkWidgetWrite54, BlynkWidgetWrite55,
+    BlynkWidgetWrite56, BlynkWidgetWrite57, BlynkWidgetWrite58, BlynkWidgetWrite59, BlynkWidgetWrite60, BlynkWidgetWrite61, BlynkWidgetWrite62, BlynkWidgetWrite63};
+
+  void blynkDeliver(int pin)
+  {
+    if (pin < 0 || pin >= (int)(sizeof(blynkHandlers) / sizeof(blynkHandlers[0])))
+      return;
+    std::map<int, double>::const_iterator it = blynkAppValues.find(pin);
+    if (it == blynkAppValues.end())
+      return;
+    BlynkReq request = {(uint8_t)pin};
+    BlynkParam param(it->second);
+    blynkHandlers[pin](request, param);
+  }
+}
+
+bool BlynkClass::connect(unsigned long timeout)
+{
+  if (!wifiConnected || !blynkConnected)
+  {
+    hal::busyWait((uint64_t)timeout * 1000ULL);
+    return false;
+  }
+  BlynkOnConnected();
+  return true;
+}
+
+bool BlynkClass::connected()
+{
+  return wifiConnected && blynkConnected;
+}
+
+void BlynkClass::run()
+{
+  if (!connected())
+    return;
+  std::vector<int> pending;
+  pending.swap(blynkPending);
+  for (int pin : pending)
+    blynkDeliver(pin);
+}
+
+void BlynkClass::syncAll()
+{
+  for (const std::pair<const int, double> &value : blynkAppValues)
+    blynkDeliver(value.first);
+}
+
+void BlynkClass::syncVirtual(int pin)
+{
+  blynkDeliver(pin);
+}
+
+void BlynkClass::virtualWriteValues(int pin, const double *values, size_t count)
+{
+  if (count > 0)
+    blynkDeviceValues[pin] = values[0];
+}
+
+/********************************************************
+  MQTT
+******************************************************/
+bool MQTTClient::connect(const char *clientId, const char *username, const char *password)
+{
+  (void)clientId;
+  (void)username;
+  (void)password;
+  return mqttConnected;
+}
+
+bool MQTTClient::connected()
+{
+  return mqttConnected;
+}
+
+bool MQTTClient::loop()
+{
+  if (!mqttConnected)
+    return false;
+  for (std::pair<String, String> &message : mqttPending)
+  {
+    if (callback)
+      callback(message.first, message.second);
+    if (advancedCallback)
+    {
+      // like the library: terminated topic, payload bytes with their length
+      std::string topic = message.first.c_str();
+      std::string payload = message.second.c_str();
+      advancedCallback(this, &topic[0], &payload[0], (int)payload.length());
+    }
+  }
+  mqttPending.clear(); // keeps its capacity, no allocation per message
+  return true;
+}
+
+bool MQTTClient::subscribe(const char *topic)
+{
+  (void)topic;
+  return mqttConnected;
+}
+
+bool MQTTClient::publish(const char *topic, const char *payload)
+{
+  (void)topic;
+  (void)payload;
+  return mqttConnected;
+}
+
+/********************************************************
+  HX711, conversions finish on a fixed grid in virtual time.
+  DOUT goes LOW when a conversion is ready (data ready
+  interrupt) and HIGH again once it has been read.
+******************************************************/
+namespace
+{
+  void hx711ConversionReady(void *context)
+  {
+    hal::setDigitalInput(*(byte *)context, LOW);
+  }
+}
+
+void HX711::begin(byte dout, byte pd_sck, byte gain)
+{
+  (void)gain;
+  this->dout = dout;
+  this->sck = pd_sck;
+  lastConversion = hal::nowMicros();
+  hal::setDigitalInput(dout, HIGH);
+  uint64_t period = 1000000ULL / loadCellRate;
+  hal::addPeriodic(period, period - lastConversion % period, hx711ConversionReady, &this->dout);
+}
+
+bool HX711::is_ready()
+{
+  uint64_t period = 1000000ULL / loadCellRate;
+  return hal::nowMicros() / period > lastConversion / period;
+}
+
+void HX711::wait_ready(unsigned long delay_ms)
+{
+  while (!is_ready())
+    delay(delay_ms ? delay_ms : 1);
+}
+
+long HX711::read()
+{
+  uint64_t period = 1000000ULL / loadCellRate;
+  if (!is_ready())
+  {
+    uint64_t wait = (lastConversion / period + 1) * period - hal::nowMicros();
+    hal::mutableStats().hx711BusyUs += wait;
+    hal::busyWait(wait);
+  }
+  lastConversion = hal::nowMicros();
+  hal::setDigitalInput(dout, HIGH);
+  return loadCellSource ? loadCellSource(dout, loadCellContext) : 0;
+}
+
+long HX711::read_average(byte times)
+{
+  long long sum = 0;
+  for (byte i = 0; i < times; i++)
+    sum += read();
+  return times ? (long)(sum / times) : 0;
+}
+
+/********************************************************
+  U8g2
+******************************************************/
+const u8g2_cb_t u8g2_cb_r0 = {0}, u8g2_cb_r1 = {1}, u8g2_cb_r2 = {2}, u8g2_cb_r3 = {3};
+const uint8_t u8g2_font_profont11_tf[] = {6, 11, 8};
+const uint8_t u8g2_font_6x12_tf[] = {6, 12, 9};
+const uint8_t u8g2_font_IPAandRUSLCD_tf[] = {7, 10, 8};
+const uint8_t u8g2_font_4x6_tf[] = {4, 6, 5};
+
+U8G2::U8G2(const u8g2_cb_t *rotation) : rotation(rotation)
+{
+  clearBuffer();
+  display = this;
+}
+
+void U8G2::sendBuffer()
+{
+  updateDisplayArea(0, 0, getBufferTileWidth(), getBufferTileHeight());
+}
+
+void U8G2::updateDisplayArea(uint8_t tx, uint8_t ty, uint8_t tw, uint8_t th)
+{
+  for (uint8_t y = ty; y < ty + th && y < getBufferTileHeight(); y++)
+  {
+    for (uint8_t x = tx; x < tx + tw && x < getBufferTileWidth(); x++)
+      memcpy(panel + (y * width + x * 8), buffer + (y * width + x * 8), 8);
+  }
+  uint64_t bytes = (uint64_t)tw * th * 8 + th * 4; // tile data plus page/column addressing per page
+  hal::Stats &stats = hal::mutableStats();
+  stats.i2cBytes += bytes;
+  stats.i2cBusyUs += bytes * i2cByteUs;
+  hal::busyWait(bytes * i2cByteUs);
+}
+
+void U8G2::setFont(const uint8_t *font)
+{
+  fontWidth = font[0];
+  fontHeight = font[1];
+  fontAscent = font[2];
+}
+
+void U8G2::setPixel(int16_t x, int16_t y, uint8_t color)
+{
+  if (x < 0 || y < 0 || x >= width || y >= height)
+    return;
+  uint8_t &cell = buffer[(y / 8) * width + x];
+  uint8_t mask = 1 << (y & 7);
+  if (color == 0)
+    cell &= ~mask;
+  else if (color == 2)
+    cell ^= mask;
+  else
+    cell |= mask;
+}
+
+void U8G2::drawPixel(int16_t x, int16_t y)
+{
+  setPixel(x, y, drawColor);
+}
+
+void U8G2::drawHLine(int16_t x, int16_t y, int16_t w)
+{
+  for (int16_t i = 0; i < w; i++)
+    drawPixel(x + i, y);
+}
+
+void U8G2::drawVLine(int16_t x, int16_t y, int16_t h)
+{
+  for (int16_t i = 0; i < h; i++)
+    drawPixel(x, y + i);
+}
+
+void U8G2::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+  int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int16_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int16_t err = dx + dy;
+  for (;;)
+  {
+    drawPixel(x0, y0);
+    if (x0 == x1 && y0 == y1)
+      break;
+    int16_t e2 = 2 * err;
+    if (e2 >= dy)
+    {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx)
+    {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+void U8G2::drawFrame(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  drawHLine(x, y, w);
+  drawHLine(x, y + h - 1, w);
+  drawVLine(x, y, h);
+  drawVLine(x + w - 1, y, h);
+}
+
+void U8G2::drawBox(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  for (int16_t i = 0; i < h; i++)
+    drawHLine(x, y + i, w);
+}
+
+void U8G2::drawXBMP(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *bitmap)
+{
+  int16_t rowBytes = (w + 7) / 8;
+  for (int16_t row = 0; row < h; row++)
+  {
+    for (int16_t column = 0; column < w; column++)
+    {
+      if (bitmap[row * rowBytes + column / 8] & (1 << (column & 7)))
+        drawPixel(x + column, y + row);
+      else if (!bitmapTransparent)
+        setPixel(x + column, y + row, drawColor == 0 ? 1 : 0);
+    }
+  }
+}
+
+// placeholder glyph: a pattern derived from the character code, sized like the selected font
+uint16_t U8G2::drawGlyph(int16_t x, int16_t y, uint16_t encoding)
+{
+  int16_t top = posTop ? y : y - fontAscent;
+  if (encoding != ' ')
+  {
+    uint32_t pattern = encoding * 2654435761u;
+    for (uint8_t row = 1; row < fontHeight - 1; row++)
+    {
+      for (uint8_t column = 0; column < fontWidth - 1; column++)
+      {
+        if ((pattern >> ((row * 5 + column) & 31)) & 1)
+          drawPixel(x + column, top + row);
+      }
+    }
+  }
+  return fontWidth;
+}
+
+uint16_t U8G2::drawStr(int16_t x, int16_t y, const char *s)
+{
+  uint16_t w = 0;
+  while (*s)
+    w += drawGlyph(x + w, y, (uint8_t)*s++);
+  return w;
+}
+
+size_t U8G2::write(uint8_t c)
+{
+  cursorX += drawGlyph(cursorX, cursorY, c);
+  return 1;
+}
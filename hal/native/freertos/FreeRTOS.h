@@ -0,0 +1,45 @@
+/********************************************************
+  Host HAL - FreeRTOS shim
+  Tasks are cooperative coroutines on a single host thread.
+  A task runs until it blocks (notification, delay, mutex),
+  so critical sections and spinlocks are no-ops on the host.
+******************************************************/
+
+#ifndef _FreeRTOS_H
+#define _FreeRTOS_H
+
+#include <stdint.h>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef struct QueueDefinition *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1)
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+typedef struct
+{
+  uint32_t owner;
+  uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+#define portYIELD_FROM_ISR() ((void)0)
+
+#endif // _FreeRTOS_H
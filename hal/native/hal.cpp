@@ -0,0 +1,655 @@
+/********************************************************
+  Host HAL - virtual time, GPIO, hardware timers and the
+  cooperative FreeRTOS task scheduler
+******************************************************/
+
+#include <new>
+#include <stdlib.h>
+#include <ucontext.h>
+#include <time.h>
+#include <vector>
+#include "Arduino.h"
+#include "hal.h"
+#include "halInternal.h"
+
+struct hw_timer_s
+{
+  uint16_t divider;
+  uint64_t alarmValue;
+  bool autoreload;
+  bool enabled;
+  void (*isr)(void);
+  uint64_t periodUs;
+  uint64_t nextUs;
+};
+
+struct tskTaskControlBlock
+{
+  enum State
+  {
+    Ready,
+    WaitNotify,
+    Delayed,
+    Deleted
+  };
+
+  ucontext_t context;
+  std::vector<char> stack;
+  TaskFunction_t code;
+  void *parameters;
+  const char *name;
+  UBaseType_t priority;
+  State state;
+  uint64_t wakeUs;
+  uint32_t notifyValue;
+};
+
+struct QueueDefinition
+{
+  bool mutex;
+  TaskHandle_t holder;
+  uint32_t count;
+};
+
+namespace
+{
+  const uint64_t forever = UINT64_MAX;
+  const int pinCount = 64;
+
+  struct Periodic
+  {
+    int id;
+    uint64_t periodUs;
+    uint64_t nextUs;
+    hal::EventCallback callback;
+    void *context;
+  };
+
+  struct PinInterrupt
+  {
+    void (*handler)(void);
+    int mode;
+  };
+
+  uint64_t now = 0;
+  bool realtimeMode = false;
+  timespec wallStart;
+
+  uint8_t pinStates[pinCount];
+  int analogValues[pinCount];
+  PinInterrupt pinInterrupts[pinCount];
+  hal::PinWriteCallback pinWriteCallback = nullptr;
+  void *pinWriteContext = nullptr;
+
+  hw_timer_t timers[4];
+  std::vector<Periodic> periodics;
+  int nextPeriodicId = 1;
+
+  std::vector<TaskHandle_t> tasks;
+  TaskHandle_t currentTask = nullptr;
+  ucontext_t schedulerContext;
+
+  hal::Stats statistics;
+
+  uint64_t wallMicros()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(ts.tv_sec - wallStart.tv_sec) * 1000000ULL + (ts.tv_nsec - wallStart.tv_nsec) / 1000;
+  }
+
+  void pace()
+  {
+    if (!realtimeMode)
+      return;
+    uint64_t wall = wallMicros();
+    if (now > wall)
+    {
+      uint64_t wait = now - wall;
+      timespec ts = {(time_t)(wait / 1000000ULL), (long)(wait % 1000000ULL) * 1000};
+      nanosleep(&ts, nullptr);
+    }
+  }
+
+  void taskEntry(unsigned int high, unsigned int low)
+  {
+    TaskHandle_t task = (TaskHandle_t)(((uintptr_t)high << 32) | (uintptr_t)low);
+    task->code(task->parameters);
+    task->state = tskTaskControlBlock::Deleted; // returning from a task is a bug on the ESP32, just park it
+    swapcontext(&task->context, &schedulerContext);
+  }
+
+  // hand the CPU back to the scheduler, called from task context only
+  void blockCurrentTask(tskTaskControlBlock::State state, uint64_t wakeUs)
+  {
+    TaskHandle_t task = currentTask;
+    task->state = state;
+    task->wakeUs = wakeUs;
+    swapcontext(&task->context, &schedulerContext);
+  }
+
+  uint64_t ticksToWake(TickType_t ticks)
+  {
+    return ticks == portMAX_DELAY ? forever : now + (uint64_t)ticks * 1000ULL * portTICK_PERIOD_MS;
+  }
+
+  // earliest pending event: timer alarm, periodic event or task wake-up
+  uint64_t nextEvent()
+  {
+    uint64_t next = forever;
+    for (hw_timer_t &timer : timers)
+    {
+      if (timer.enabled && timer.nextUs < next)
+        next = timer.nextUs;
+    }
+    for (const Periodic &periodic : periodics)
+    {
+      if (periodic.nextUs < next)
+        next = periodic.nextUs;
+    }
+    for (TaskHandle_t task : tasks)
+    {
+      if ((task->state == tskTaskControlBlock::Delayed || task->state == tskTaskControlBlock::WaitNotify) && task->wakeUs < next)
+        next = task->wakeUs;
+    }
+    return next;
+  }
+
+  void fireEvents()
+  {
+    for (hw_timer_t &timer : timers)
+    {
+      if (timer.enabled && timer.nextUs <= now)
+      {
+        if (timer.autoreload)
+          timer.nextUs += timer.periodUs;
+        else
+          timer.enabled = false;
+        statistics.timerIsrCalls++;
+        if (timer.isr)
+          timer.isr();
+      }
+    }
+    for (size_t i = 0; i < periodics.size(); i++)
+    {
+      if (periodics[i].nextUs <= now)
+      {
+        periodics[i].nextUs += periodics[i].periodUs;
+        periodics[i].callback(periodics[i].context);
+      }
+    }
+  }
+}
+
+namespace hal
+{
+  uint64_t nowMicros()
+  {
+    return now;
+  }
+
+  void setRealtime(bool enabled)
+  {
+    realtimeMode = enabled;
+    clock_gettime(CLOCK_MONOTONIC, &wallStart);
+    if (enabled && now > 0)
+    {
+      // keep wall clock and virtual time aligned from here on
+      uint64_t offset = now;
+      wallStart.tv_sec -= offset / 1000000ULL;
+      wallStart.tv_nsec -= (offset % 1000000ULL) * 1000;
+      if (wallStart.tv_nsec < 0)
+      {
+        wallStart.tv_nsec += 1000000000L;
+        wallStart.tv_sec--;
+      }
+    }
+  }
+
+  bool realtime()
+  {
+    return realtimeMode;
+  }
+
+  void advance(uint64_t us)
+  {
+    if (currentTask)
+    {
+      // a task waiting for time simply sleeps, the scheduler moves the clock
+      blockCurrentTask(tskTaskControlBlock::Delayed, now + us);
+      return;
+    }
+    uint64_t target = now + us;
+    runTasks();
+    for (;;)
+    {
+      uint64_t next = nextEvent();
+      if (next > target)
+        break;
+      if (next > now)
+        now = next;
+      fireEvents();
+      runTasks();
+    }
+    now = target;
+    runTasks();
+    pace();
+  }
+
+  void busyWait(uint64_t us)
+  {
+    advance(us);
+  }
+
+  void runTasks()
+  {
+    if (currentTask)
+      return;
+    for (;;)
+    {
+      TaskHandle_t next = nullptr;
+      for (TaskHandle_t task : tasks)
+      {
+        if ((task->state == tskTaskControlBlock::Delayed || task->state == tskTaskControlBlock::WaitNotify) && task->wakeUs <= now)
+          task->state = tskTaskControlBlock::Ready;
+        if (task->state == tskTaskControlBlock::Ready && (!next || task->priority > next->priority))
+          next = task;
+      }
+      if (!next)
+        return;
+      currentTask = next;
+      statistics.taskSwitches++;
+      swapcontext(&schedulerContext, &next->context);
+      currentTask = nullptr;
+    }
+  }
+
+  int addPeriodic(uint64_t periodUs, uint64_t phaseUs, EventCallback callback, void *context)
+  {
+    Periodic periodic = {nextPeriodicId++, periodUs, now + phaseUs, callback, context};
+    periodics.push_back(periodic);
+    return periodic.id;
+  }
+
+  void removePeriodic(int id)
+  {
+    for (size_t i = 0; i < periodics.size(); i++)
+    {
+      if (periodics[i].id == id)
+      {
+        periodics.erase(periodics.begin() + i);
+        return;
+      }
+    }
+  }
+
+  uint8_t pinState(uint8_t pin)
+  {
+    return pin < pinCount ? pinStates[pin] : LOW;
+  }
+
+  void setDigitalInput(uint8_t pin, uint8_t level)
+  {
+    if (pin >= pinCount)
+      return;
+    uint8_t previous = pinStates[pin];
+    pinStates[pin] = level;
+    PinInterrupt &irq = pinInterrupts[pin];
+    if (!irq.handler || previous == level)
+      return;
+    if (irq.mode == CHANGE || (irq.mode == RISING && level == HIGH) || (irq.mode == FALLING && level == LOW))
+    {
+      statistics.gpioIsrCalls++;
+      irq.handler();
+      runTasks();
+    }
+  }
+
+  void setAnalogInput(uint8_t pin, int value)
+  {
+    if (pin < pinCount)
+      analogValues[pin] = value;
+  }
+
+  void onPinWrite(PinWriteCallback callback, void *context)
+  {
+    pinWriteCallback = callback;
+    pinWriteContext = context;
+  }
+
+  const Stats &stats()
+  {
+    return statistics;
+  }
+
+  Stats &mutableStats()
+  {
+    return statistics;
+  }
+
+  void resetStats()
+  {
+    statistics = Stats();
+  }
+}
+
+/********************************************************
+  Arduino time and GPIO
+******************************************************/
+unsigned long millis()
+{
+  return (unsigned long)(now / 1000ULL);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)now;
+}
+
+int64_t esp_timer_get_time()
+{
+  return (int64_t)now;
+}
+
+void delay(uint32_t ms)
+{
+  hal::advance((uint64_t)ms * 1000ULL);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  hal::advance(us);
+}
+
+void yield()
+{
+  // a busy-waiting caller must still see time pass
+  hal::advance(100);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin < pinCount && mode == INPUT_PULLUP)
+    pinStates[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  if (pin >= pinCount)
+    return;
+  pinStates[pin] = val ? HIGH : LOW;
+  if (pinWriteCallback)
+    pinWriteCallback(pin, pinStates[pin], pinWriteContext);
+}
+
+int digitalRead(uint8_t pin)
+{
+  return hal::pinState(pin);
+}
+
+uint16_t analogRead(uint8_t pin)
+{
+  return pin < pinCount ? analogValues[pin] : 0;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+  if (pin < pinCount)
+    pinInterrupts[pin] = {handler, mode};
+}
+
+void detachInterrupt(uint8_t pin)
+{
+  if (pin < pinCount)
+    pinInterrupts[pin] = {nullptr, 0};
+}
+
+/********************************************************
+  Hardware timer, APB clock is 80 MHz
+******************************************************/
+hw_timer_t *timerBegin(uint8_t num, uint16_t divider, bool countUp)
+{
+  (void)countUp;
+  hw_timer_t *timer = &timers[num & 3];
+  *timer = hw_timer_t();
+  timer->divider = divider;
+  return timer;
+}
+
+void timerEnd(hw_timer_t *timer)
+{
+  timer->enabled = false;
+}
+
+void timerAttachInterrupt(hw_timer_t *timer, void (*fn)(void), bool edge)
+{
+  (void)edge;
+  timer->isr = fn;
+}
+
+void timerDetachInterrupt(hw_timer_t *timer)
+{
+  timer->isr = nullptr;
+}
+
+void timerAlarmWrite(hw_timer_t *timer, uint64_t alarmValue, bool autoreload)
+{
+  timer->alarmValue = alarmValue;
+  timer->autoreload = autoreload;
+  timer->periodUs = alarmValue * timer->divider / 80;
+  if (timer->periodUs == 0)
+    timer->periodUs = 1;
+}
+
+void timerAlarmEnable(hw_timer_t *timer)
+{
+  if (!timer->enabled)
+    timer->nextUs = now + timer->periodUs;
+  timer->enabled = true;
+}
+
+void timerAlarmDisable(hw_timer_t *timer)
+{
+  timer->enabled = false;
+}
+
+/********************************************************
+  FreeRTOS tasks
+******************************************************/
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t taskCode, const char *name, uint32_t stackDepth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *createdTask, BaseType_t coreId)
+{
+  (void)coreId;
+  TaskHandle_t task = new tskTaskControlBlock();
+  task->code = taskCode;
+  task->parameters = parameters;
+  task->name = name;
+  task->priority = priority;
+  task->state = tskTaskControlBlock::Ready;
+  task->stack.resize(std::max<uint32_t>(stackDepth * 4, 256 * 1024));
+  getcontext(&task->context);
+  task->context.uc_stack.ss_sp = task->stack.data();
+  task->context.uc_stack.ss_size = task->stack.size();
+  task->context.uc_link = nullptr;
+  uintptr_t address = (uintptr_t)task;
+  makecontext(&task->context, (void (*)())taskEntry, 2, (unsigned int)(address >> 32), (unsigned int)(address & 0xffffffffu));
+  tasks.push_back(task);
+  if (createdTask)
+    *createdTask = task;
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t taskCode, const char *name, uint32_t stackDepth, void *parameters,
+                       UBaseType_t priority, TaskHandle_t *createdTask)
+{
+  return xTaskCreatePinnedToCore(taskCode, name, stackDepth, parameters, priority, createdTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+  if (!task)
+    task = currentTask;
+  if (!task)
+    return;
+  task->state = tskTaskControlBlock::Deleted;
+  if (task == currentTask)
+    swapcontext(&task->context, &schedulerContext);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  hal::advance((uint64_t)ticks * 1000ULL * portTICK_PERIOD_MS);
+}
+
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t timeIncrement)
+{
+  *previousWakeTime += timeIncrement;
+  uint64_t wakeUs = (uint64_t)*previousWakeTime * 1000ULL * portTICK_PERIOD_MS;
+  if (wakeUs > now)
+    hal::advance(wakeUs - now);
+}
+
+TickType_t xTaskGetTickCount()
+{
+  return (TickType_t)(now / (1000ULL * portTICK_PERIOD_MS));
+}
+
+TickType_t xTaskGetTickCountFromISR()
+{
+  return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  return currentTask;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+  (void)task;
+  return 0;
+}
+
+BaseType_t xPortGetCoreID()
+{
+  return currentTask ? 0 : 1;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+  TaskHandle_t task = currentTask;
+  if (!task)
+    return 0; // the loop() context has no notification slot
+  if (task->notifyValue == 0 && ticksToWait != 0)
+    blockCurrentTask(tskTaskControlBlock::WaitNotify, ticksToWake(ticksToWait));
+  uint32_t value = task->notifyValue;
+  if (value > 0)
+    task->notifyValue = clearCountOnExit ? 0 : value - 1;
+  return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+  task->notifyValue++;
+  if (task->state == tskTaskControlBlock::WaitNotify)
+    task->state = tskTaskControlBlock::Ready;
+  hal::runTasks(); // a higher priority task preempts the caller right away
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+  task->notifyValue++;
+  if (task->state == tskTaskControlBlock::WaitNotify)
+  {
+    task->state = tskTaskControlBlock::Ready;
+    if (higherPriorityTaskWoken)
+      *higherPriorityTaskWoken = pdTRUE;
+  }
+}
+
+/********************************************************
+  FreeRTOS semaphores
+******************************************************/
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  SemaphoreHandle_t semaphore = new QueueDefinition();
+  semaphore->mutex = true;
+  semaphore->count = 1;
+  return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+  SemaphoreHandle_t semaphore = new QueueDefinition();
+  semaphore->mutex = false;
+  semaphore->count = 0;
+  return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+  uint64_t deadline = ticksToWake(ticksToWait);
+  while (semaphore->count == 0)
+  {
+    // the holder is blocked somewhere, let time pass until it gives the semaphore back
+    if (now >= deadline)
+      return pdFALSE;
+    hal::advance(1000);
+  }
+  semaphore->count--;
+  semaphore->holder = currentTask;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+  if (semaphore->mutex && semaphore->count > 0)
+    return pdFALSE;
+  semaphore->count++;
+  semaphore->holder = nullptr;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higherPriorityTaskWoken)
+{
+  (void)higherPriorityTaskWoken;
+  return xSemaphoreGive(semaphore);
+}
+
+/********************************************************
+  Heap, every operator new counts in hal::Stats::heapAllocs
+******************************************************/
+void *operator new(size_t size)
+{
+  void *memory = malloc(size ? size : 1);
+  if (!memory)
+    throw std::bad_alloc();
+  statistics.heapAllocs++;
+  return memory;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+  free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+  free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+  free(memory);
+}
@@ -0,0 +1,89 @@
+/********************************************************
+  Host HAL - control interface for the native build
+  The firmware in src/ runs unchanged on Linux against the
+  shim headers in this directory. Time is virtual: it only
+  moves when hal::advance() is called (or the firmware
+  calls delay()/yield()), so a simulation can run much
+  faster than real time and is fully deterministic.
+******************************************************/
+
+#ifndef _hal_H
+#define _hal_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace hal
+{
+  typedef void (*EventCallback)(void *context);
+  typedef void (*PinWriteCallback)(uint8_t pin, uint8_t level, void *context);
+  typedef float (*TemperatureSource)(void *context);
+  typedef long (*LoadCellSource)(uint8_t doutPin, void *context);
+
+  /********************************************************
+    Virtual time
+  ******************************************************/
+  uint64_t nowMicros();
+  void advance(uint64_t us);      // move time forward, firing timers, interrupts and tasks on the way
+  void setRealtime(bool enabled); // true = advance() paces itself against the wall clock
+  bool realtime();
+  void busyWait(uint64_t us);     // blocking peripheral access (I2C, HX711, ...) from firmware code
+  void runTasks();                // run all tasks that became ready at the current time
+
+  // periodic event in virtual time, e.g. a simulated zero-cross signal
+  int addPeriodic(uint64_t periodUs, uint64_t phaseUs, EventCallback callback, void *context);
+  void removePeriodic(int id);
+
+  /********************************************************
+    GPIO
+  ******************************************************/
+  uint8_t pinState(uint8_t pin);
+  void setDigitalInput(uint8_t pin, uint8_t level); // fires attached interrupts on edges
+  void setAnalogInput(uint8_t pin, int value);
+  void onPinWrite(PinWriteCallback callback, void *context);
+
+  /********************************************************
+    Sensors
+  ******************************************************/
+  void setTemperature(float celsius);
+  void setTemperatureSource(TemperatureSource source, void *context);
+  float temperature();
+  void setLoadCellSource(LoadCellSource source, void *context);
+  void setLoadCellRate(uint32_t samplesPerSecond); // HX711 conversion rate, 10 or 80 SPS
+
+  /********************************************************
+    Network
+  ******************************************************/
+  void setWifiConnected(bool connected);
+  void setBlynkConnected(bool connected);
+  void blynkAppWrite(int pin, double value); // value set in the app, delivered by Blynk.run()/sync
+  double blynkLastWrite(int pin);            // last value the firmware sent to the app
+  void setMqttConnected(bool connected);
+  void mqttPublishToDevice(const char *topic, const char *payload);
+
+  /********************************************************
+    Persistence, console and statistics
+  ******************************************************/
+  void setEepromFile(const char *path);
+  void setFlashDirectory(const char *path); // SPIFFS files, SPIFFS.begin() fails without one
+  void setSerialEnabled(bool enabled);
+
+  struct Stats
+  {
+    uint64_t i2cBytes;      // bytes pushed to the display
+    uint64_t i2cBusyUs;     // time spent blocked on the display bus
+    uint64_t hx711BusyUs;   // time spent waiting for HX711 conversions
+    uint64_t timerIsrCalls; // hardware timer interrupts
+    uint64_t gpioIsrCalls;  // pin change interrupts
+    uint64_t taskSwitches;  // context switches into tasks
+    uint64_t flashBytes;    // bytes written to SPIFFS files
+    uint64_t heapAllocs;    // operator new calls, String included, of firmware and shims alike
+  };
+  const Stats &stats();
+  void resetStats();
+
+  // bitmap the simulated 128x64 display shows (u8g2 page layout), as far as sent over the bus
+  const uint8_t *displayBuffer();
+}
+
+#endif // _hal_H
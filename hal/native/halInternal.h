@@ -0,0 +1,15 @@
+/********************************************************
+  Host HAL - shared between the HAL translation units only
+******************************************************/
+
+#ifndef _halInternal_H
+#define _halInternal_H
+
+#include "hal.h"
+
+namespace hal
+{
+  Stats &mutableStats();
+}
+
+#endif // _halInternal_H
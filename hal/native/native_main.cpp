@@ -0,0 +1,49 @@
+/********************************************************
+  Host HAL - entry point of the native build
+  Runs the firmware setup()/loop() on Linux.
+    --fast          run as fast as possible instead of real time
+    --seconds N     stop after N seconds of (virtual) time
+    --loop-us N     time one loop() pass takes, default 1000 us
+    --eeprom FILE   keep the emulated EEPROM in FILE
+    --flash DIR     keep the SPIFFS files in DIR
+    --quiet         drop Serial output
+******************************************************/
+
+#include "Arduino.h"
+#include "hal.h"
+
+void setup();
+void loop();
+
+int main(int argc, char **argv)
+{
+  bool fast = false;
+  double seconds = 0;
+  unsigned long loopUs = 1000;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--fast"))
+      fast = true;
+    else if (!strcmp(argv[i], "--seconds") && i + 1 < argc)
+      seconds = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--loop-us") && i + 1 < argc)
+      loopUs = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--eeprom") && i + 1 < argc)
+      hal::setEepromFile(argv[++i]);
+    else if (!strcmp(argv[i], "--flash") && i + 1 < argc)
+      hal::setFlashDirectory(argv[++i]);
+    else if (!strcmp(argv[i], "--quiet"))
+      hal::setSerialEnabled(false);
+  }
+
+  hal::setRealtime(!fast);
+  setup();
+  uint64_t end = seconds > 0 ? (uint64_t)(seconds * 1e6) : UINT64_MAX;
+  while (hal::nowMicros() < end)
+  {
+    loop();
+    hal::advance(loopUs);
+  }
+  fflush(stdout);
+  return 0;
+}
@@ -0,0 +1,174 @@
+/********************************************************
+  BoilerPID - single precision PID for the control task
+******************************************************/
+
+#include <Arduino.h>
+#include "boilerPID.h"
+
+BoilerPID::BoilerPID(float *input, float *output, float *setPoint, float kp, float ki, float kd, int pOn, int direction)
+    : direction(direction), inAuto(false), input(input), output(output), setPoint(setPoint), sampleTime(100),
+      outputSum(0), lastInput(0)
+{
+  SetOutputLimits(0, 255);
+  SetTunings(kp, ki, kd, pOn);
+  lastTime = millis() - sampleTime;
+}
+
+/********************************************************
+  Compute - runs at most once per sample time
+******************************************************/
+bool BoilerPID::Compute()
+{
+  if (!inAuto)
+    return false;
+
+  unsigned long now = millis();
+  if (now - lastTime < sampleTime)
+    return false;
+
+  float in = *input;
+  float error = *setPoint - in;
+  float dInput = in - lastInput;
+
+  outputSum += ki * error;
+  if (!pOnE)
+  {
+    outputSum -= kp * dInput; // proportional on measurement
+  }
+
+  // anti-windup: the integral never leaves the output range
+  if (outputSum > outMax)
+  {
+    outputSum = outMax;
+  }
+  else if (outputSum < outMin)
+  {
+    outputSum = outMin;
+  }
+
+  float out = pOnE ? kp * error : 0;
+  out += outputSum - kd * dInput;
+
+  if (out > outMax)
+  {
+    out = outMax;
+  }
+  else if (out < outMin)
+  {
+    out = outMin;
+  }
+  *output = out;
+
+  lastInput = in;
+  lastTime = now;
+  return true;
+}
+
+void BoilerPID::SetTunings(float kp, float ki, float kd, int pOn)
+{
+  if (kp < 0 || ki < 0 || kd < 0)
+    return;
+
+  this->pOn = pOn;
+  pOnE = pOn == P_ON_E;
+
+  dispKp = kp;
+  dispKi = ki;
+  dispKd = kd;
+
+  float sampleTimeInSec = sampleTime / 1000.0f;
+  this->kp = kp;
+  this->ki = ki * sampleTimeInSec;
+  this->kd = kd / sampleTimeInSec;
+
+  if (direction == REVERSE)
+  {
+    this->kp = -this->kp;
+    this->ki = -this->ki;
+    this->kd = -this->kd;
+  }
+}
+
+void BoilerPID::SetTunings(float kp, float ki, float kd)
+{
+  SetTunings(kp, ki, kd, pOn);
+}
+
+void BoilerPID::SetSampleTime(int sampleTime)
+{
+  if (sampleTime <= 0)
+    return;
+
+  float ratio = (float)sampleTime / (float)this->sampleTime;
+  ki *= ratio;
+  kd /= ratio;
+  this->sampleTime = (unsigned long)sampleTime;
+}
+
+void BoilerPID::SetOutputLimits(float min, float max)
+{
+  if (min >= max)
+    return;
+
+  outMin = min;
+  outMax = max;
+
+  if (inAuto)
+  {
+    if (*output > outMax)
+    {
+      *output = outMax;
+    }
+    else if (*output < outMin)
+    {
+      *output = outMin;
+    }
+
+    if (outputSum > outMax)
+    {
+      outputSum = outMax;
+    }
+    else if (outputSum < outMin)
+    {
+      outputSum = outMin;
+    }
+  }
+}
+
+/********************************************************
+  SetMode - bumpless transfer from manual to automatic
+******************************************************/
+void BoilerPID::SetMode(int mode)
+{
+  bool newAuto = mode == AUTOMATIC;
+  if (newAuto && !inAuto)
+  {
+    Initialize();
+  }
+  inAuto = newAuto;
+}
+
+void BoilerPID::Initialize()
+{
+  outputSum = *output;
+  lastInput = *input;
+  if (outputSum > outMax)
+  {
+    outputSum = outMax;
+  }
+  else if (outputSum < outMin)
+  {
+    outputSum = outMin;
+  }
+}
+
+void BoilerPID::SetControllerDirection(int direction)
+{
+  if (inAuto && direction != this->direction)
+  {
+    kp = -kp;
+    ki = -ki;
+    kd = -kd;
+  }
+  this->direction = direction;
+}
@@ -0,0 +1,62 @@
+/********************************************************
+  BoilerPID - single precision PID for the control task
+  Same algorithm and API as br3ttb PID_v1 (P_ON_E/P_ON_M,
+  output clamping as anti-windup, SetTunings/SetMode), but
+  in float so it runs on the ESP32 FPU instead of software
+  emulated double. The FPU may only be used from a task
+  pinned to one core, so call Compute() from the control task.
+******************************************************/
+
+#ifndef _boilerPID_H
+#define _boilerPID_H
+
+#ifndef AUTOMATIC
+#define AUTOMATIC 1
+#define MANUAL 0
+#define DIRECT 0
+#define REVERSE 1
+#define P_ON_M 0
+#define P_ON_E 1
+#endif
+
+class BoilerPID
+{
+public:
+  BoilerPID(float *input, float *output, float *setPoint, float kp, float ki, float kd, int pOn, int direction);
+
+  bool Compute(); // true if a new output was calculated
+  void SetMode(int mode);
+  void SetOutputLimits(float min, float max);
+  void SetTunings(float kp, float ki, float kd);
+  void SetTunings(float kp, float ki, float kd, int pOn);
+  void SetControllerDirection(int direction);
+  void SetSampleTime(int sampleTime); // ms
+
+  float GetKp() const { return dispKp; }
+  float GetKi() const { return dispKi; }
+  float GetKd() const { return dispKd; }
+  int GetMode() const { return inAuto ? AUTOMATIC : MANUAL; }
+  int GetDirection() const { return direction; }
+
+private:
+  void Initialize();
+
+  float dispKp, dispKi, dispKd; // tunings as passed in, for display
+  float kp, ki, kd;             // tunings scaled to the sample time
+  int direction;
+  int pOn;
+  bool pOnE;
+  bool inAuto;
+
+  float *input;
+  float *output;
+  float *setPoint;
+
+  unsigned long lastTime;
+  unsigned long sampleTime;
+  float outputSum;
+  float lastInput;
+  float outMin, outMax;
+};
+
+#endif // _boilerPID_H
@@ -0,0 +1,71 @@
+/********************************************************
+  Control state shared between loop() and the control task
+  Each direction has exactly one writer and is published
+  through a seqlock, so readers always see a consistent set
+  of values (no torn 64 bit doubles) and nobody has to hold
+  a lock while the other side is working.
+******************************************************/
+
+#ifndef _controlState_H
+#define _controlState_H
+
+#include <atomic>
+#include <stdint.h>
+
+struct ControlState
+{
+  double input;       // temperature the PID works with
+  double setPoint;    // target temperature
+  double kp;          // tunings as passed to SetTunings()
+  double ki;
+  double kd;
+  int pOn;            // P_ON_E or P_ON_M
+  int mode;           // AUTOMATIC or MANUAL
+  double output;      // heater output, set by the control task, in MANUAL requested by loop()
+  double feedForward; // added to the PID output in AUTOMATIC (brew boost)
+  int controller;     // 0 = PID, 1 = PID with Smith predictor
+  int pump;           // PUMPMODE 1, requested by loop(): 0 = off, 1 = full power, 2 = pump profile
+  int profileSegment; // set by the control task: segment of the pump profile, see PumpProfile::segment()
+};
+
+template <typename T>
+class Seqlock
+{
+public:
+  // single writer only
+  void write(const T &value)
+  {
+    uint32_t sequence = this->sequence.load(std::memory_order_relaxed);
+    this->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    data = value;
+    this->sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  // false if the writer was active, value is undefined then
+  bool tryRead(T &value) const
+  {
+    uint32_t before = sequence.load(std::memory_order_acquire);
+    if (before & 1)
+      return false;
+    value = data;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return sequence.load(std::memory_order_relaxed) == before;
+  }
+
+  // retries until consistent, only for readers that cannot block the writer
+  T read() const
+  {
+    T value;
+    while (!tryRead(value))
+    {
+    }
+    return value;
+  }
+
+private:
+  std::atomic<uint32_t> sequence{0};
+  T data = T();
+};
+
+#endif // _controlState_H
@@ -0,0 +1,184 @@
+/********************************************************
+  DeadlineScheduler - periodic jobs of loop()
+******************************************************/
+
+#include <Arduino.h>
+#include "deadlineScheduler.h"
+
+bool DeadlineScheduler::add(const char *name, unsigned long periodMs, void (*function)())
+{
+  if (count == maxJobs || periodMs == 0)
+  {
+    return false;
+  }
+  Job &job = jobs[count];
+  job = Job();
+  job.name = name;
+  job.function = function;
+  job.period = periodMs * 1000;
+  job.due = micros() + job.period;
+  heap[count] = count;
+  count++;
+  siftUp(count - 1);
+  if (count == 1)
+  {
+    statsStart = micros();
+  }
+  return true;
+}
+
+void DeadlineScheduler::run()
+{
+  if (count == 0)
+  {
+    return;
+  }
+  unsigned long now = micros();
+  while ((long)(now - jobs[heap[0]].due) >= 0)
+  {
+    uint8_t index = heap[0];
+    Job &job = jobs[index];
+    uint32_t late = now - job.due;
+    job.runs++;
+    job.lateSum += late;
+    if (late > job.lateMax)
+    {
+      job.lateMax = late;
+    }
+
+    running = index;
+    runningMoved = false;
+    job.function();
+    running = noJob;
+
+    unsigned long done = micros();
+    if (done - now > job.runMax)
+    {
+      job.runMax = done - now;
+    }
+    if (!runningMoved)
+    {
+      job.due += job.period;
+      if ((long)(done - job.due) >= 0)
+      {
+        job.due = done + job.period; // overran a whole period, skip the missed runs
+      }
+    }
+    uint8_t at = position(index); // runWithin() of another job may have moved it off the top
+    siftDown(at);
+    siftUp(at);
+    now = done;
+  }
+
+  unsigned long wait = jobs[heap[0]].due - now;
+  if (wait >= 1000)
+  {
+    delay(wait / 1000); // blocks the loop task, the idle task (and light sleep) gets the core
+  }
+  else
+  {
+    yield();
+  }
+  idleUs += micros() - now;
+}
+
+void DeadlineScheduler::runWithin(void (*function)(), unsigned long ms)
+{
+  uint8_t index = 0;
+  while (index < count && jobs[index].function != function)
+  {
+    index++;
+  }
+  if (index == count)
+  {
+    return;
+  }
+  Job &job = jobs[index];
+  unsigned long due = micros() + ms * 1000;
+  if (index == running)
+  {
+    // run() sets the next due after the job, unless it was moved here already
+    unsigned long next = runningMoved ? job.due : job.due + job.period;
+    if ((long)(due - next) < 0)
+    {
+      job.due = due;
+      runningMoved = true;
+    }
+  }
+  else if ((long)(due - job.due) < 0)
+  {
+    job.due = due;
+    siftUp(position(index));
+  }
+}
+
+float DeadlineScheduler::idlePercent() const
+{
+  unsigned long total = micros() - statsStart;
+  return total ? 100.0f * idleUs / total : 0;
+}
+
+void DeadlineScheduler::resetStats()
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    jobs[i].runs = 0;
+    jobs[i].lateMax = 0;
+    jobs[i].lateSum = 0;
+    jobs[i].runMax = 0;
+  }
+  idleUs = 0;
+  statsStart = micros();
+}
+
+uint8_t DeadlineScheduler::position(uint8_t job) const
+{
+  uint8_t i = 0;
+  while (heap[i] != job)
+  {
+    i++;
+  }
+  return i;
+}
+
+void DeadlineScheduler::siftUp(uint8_t position)
+{
+  while (position > 0)
+  {
+    uint8_t parent = (position - 1) / 2;
+    if (!before(heap[position], heap[parent]))
+    {
+      break;
+    }
+    uint8_t swap = heap[parent];
+    heap[parent] = heap[position];
+    heap[position] = swap;
+    position = parent;
+  }
+}
+
+void DeadlineScheduler::siftDown(uint8_t position)
+{
+  for (;;)
+  {
+    uint8_t first = position;
+    uint8_t left = 2 * position + 1;
+    uint8_t right = left + 1;
+    if (left < count && before(heap[left], heap[first]))
+    {
+      first = left;
+    }
+    if (right < count && before(heap[right], heap[first]))
+    {
+      first = right;
+    }
+    if (first == position)
+    {
+      return;
+    }
+    uint8_t swap = heap[first];
+    heap[first] = heap[position];
+    heap[position] = swap;
+    position = first;
+  }
+}
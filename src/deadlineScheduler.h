@@ -0,0 +1,71 @@
+/********************************************************
+  DeadlineScheduler - periodic jobs of loop()
+  The jobs sit in a min-heap ordered by their next deadline.
+  run() runs every job that is due and then sleeps until the
+  next deadline, so loop() no longer spins and the time it
+  sleeps is the idle time of the core. A job that is late by
+  more than its period skips the missed runs instead of
+  running them back to back. Per job the lateness of the
+  start against the deadline (jitter) and the longest run
+  are kept. runWithin() brings a job forward for an event it
+  knows the time of, e.g. the next timed transition of a
+  state machine; its period goes on from that run.
+******************************************************/
+
+#ifndef _deadlineScheduler_H
+#define _deadlineScheduler_H
+
+#include <stdint.h>
+
+class DeadlineScheduler
+{
+public:
+  static const uint8_t maxJobs = 10;
+
+  struct Job
+  {
+    const char *name;
+    void (*function)();
+    unsigned long period; // us
+    unsigned long due;    // micros() of the next run
+    uint32_t runs;        // statistics since resetStats()
+    uint32_t lateMax;     // us
+    uint64_t lateSum;     // us
+    uint32_t runMax;      // us
+  };
+
+  // setup only, the first run is one period from now, false if full
+  bool add(const char *name, unsigned long periodMs, void (*function)());
+
+  // loop(): run the due jobs, then sleep until the next deadline
+  void run();
+
+  // run the job of function within ms, if it is not due before anyway; also from inside the job itself
+  void runWithin(void (*function)(), unsigned long ms);
+
+  uint8_t size() const { return count; }
+  const Job &job(uint8_t i) const { return jobs[i]; }
+  uint32_t lateMean(uint8_t i) const { return jobs[i].runs ? jobs[i].lateSum / jobs[i].runs : 0; }
+
+  // share of the time since resetStats() spent sleeping, 0...100 %
+  float idlePercent() const;
+  void resetStats();
+
+private:
+  bool before(uint8_t a, uint8_t b) const { return (long)(jobs[a].due - jobs[b].due) < 0; }
+  void siftUp(uint8_t position);
+  void siftDown(uint8_t position);
+  uint8_t position(uint8_t job) const;
+
+  static const uint8_t noJob = 0xff;
+
+  Job jobs[maxJobs];
+  uint8_t heap[maxJobs]; // job indices, heap[0] is due first
+  uint8_t count = 0;
+  uint8_t running = noJob;    // job of the function run() is in
+  bool runningMoved = false;  // runWithin() has set its next due
+  uint64_t idleUs = 0;
+  unsigned long statsStart = 0;
+};
+
+#endif // _deadlineScheduler_H
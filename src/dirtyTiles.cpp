@@ -0,0 +1,53 @@
+/********************************************************
+  DirtyTiles - send only the changed part of a frame
+******************************************************/
+
+#include <string.h>
+#include "dirtyTiles.h"
+
+uint8_t DirtyTiles::send(U8G2 &display)
+{
+  const uint8_t *buffer = display.getBufferPtr();
+  if (display.getBufferTileWidth() != tileWidth || display.getBufferTileHeight() != tileHeight)
+  {
+    display.sendBuffer(); // other display size, no diff
+    return display.getBufferTileWidth() * display.getBufferTileHeight();
+  }
+  if (!valid)
+  {
+    memcpy(frame, buffer, sizeof(frame));
+    display.sendBuffer();
+    valid = true;
+    return tileWidth * tileHeight;
+  }
+
+  uint8_t sent = 0;
+  for (uint8_t ty = 0; ty < tileHeight; ty++)
+  {
+    uint8_t tx = 0;
+    while (tx < tileWidth)
+    {
+      uint8_t start = tx;
+      while (tx < tileWidth)
+      {
+        uint16_t offset = (ty * tileWidth + tx) * 8;
+        if (memcmp(frame + offset, buffer + offset, 8) == 0)
+        {
+          break;
+        }
+        memcpy(frame + offset, buffer + offset, 8);
+        tx++;
+      }
+      if (tx > start)
+      {
+        display.updateDisplayArea(start, ty, tx - start, 1);
+        sent += tx - start;
+      }
+      else
+      {
+        tx++; // unchanged tile
+      }
+    }
+  }
+  return sent;
+}
@@ -0,0 +1,35 @@
+/********************************************************
+  DirtyTiles - send only the changed part of a frame
+  The screens still draw the whole frame into the u8g2
+  buffer, which is cheap. Instead of sendBuffer(), send()
+  compares every tile (8x8 pixels, 8 bytes of a page) with
+  the frame sent last and transfers each run of changed
+  tiles of a page with one updateDisplayArea(). A new
+  temperature only changes a few tiles, so the bus is busy
+  for a fraction of the 1 KB full frame.
+******************************************************/
+
+#ifndef _dirtyTiles_H
+#define _dirtyTiles_H
+
+#include <U8g2lib.h>
+#include <stdint.h>
+
+class DirtyTiles
+{
+public:
+  static const uint8_t tileWidth = 16; // 128x64 display
+  static const uint8_t tileHeight = 8;
+
+  // transfers the changed tiles, returns how many
+  uint8_t send(U8G2 &display);
+
+  // the next send() transfers the whole frame, e.g. after a reset of the display
+  void invalidate() { valid = false; }
+
+private:
+  uint8_t frame[tileWidth * tileHeight * 8]; // as the display shows it
+  bool valid = false;
+};
+
+#endif // _dirtyTiles_H
@@ -0,0 +1,61 @@
+/********************************************************
+  View model of the display
+  loop() fills in a snapshot of everything a screen shows
+  and posts it to the display task through a single slot
+  mailbox (a Seqlock, see controlState.h). Only the newest
+  snapshot counts, the task renders it at its own pace and
+  never touches the firmware state itself. The graph of the
+  brew screen comes from a ring of GraphSamples instead, so
+  the task can draw every sample it missed.
+******************************************************/
+
+#ifndef _displayView_H
+#define _displayView_H
+
+#include <stdint.h>
+
+struct DisplayView
+{
+  enum Screen
+  {
+    LOGO,      // start logo and text[0..1]
+    MESSAGE,   // text[0..5]
+    STATUS,    // temperatures, heater, brew time and links
+    EMERGENCY, // temperatures, heating stopped
+    BREW       // brew time, weight and the graph
+  };
+  static const uint8_t lines = 6;
+  static const uint8_t lineLength = 22; // 21 glyphs of 6 px
+
+  uint8_t screen;
+  char text[lines][lineLength];
+
+  double input;
+  double setPoint;
+  double output;
+  double kp;
+  double ki;
+  double kd;
+  unsigned long brewTime;  // ms
+  double brewTimeLimit;    // s
+  uint8_t brewTimeDigits;  // decimals of brewTimeLimit
+  bool heaterPhase;        // first half of the heater window, for blinking
+  bool offline;
+  bool wifiConnected;
+  uint8_t bars;            // 0...4
+  unsigned int wifiReconnects;
+  bool blynkConnected;
+  bool mqtt;               // MQTT enabled
+  bool mqttConnected;
+  double weight;           // g
+  double targetWeight;
+};
+
+// one column of the brew graph, packed to 8 bits each
+struct GraphSample
+{
+  uint8_t temperature; // 0.1 °C, 128 = setPoint
+  uint8_t weight;      // 0.25 g
+};
+
+#endif // _displayView_H
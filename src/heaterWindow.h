@@ -0,0 +1,122 @@
+/********************************************************
+  HeaterWindow - time proportioning (slow PWM) of the heater
+  The window is split into slots of one timer tick each. The
+  tick is derived from the hardware timer configuration, so
+  the window length in ms is real. The PID output is mapped to
+  on-slots with the fractional remainder carried over into the
+  next window, so the average duty equals the output exactly.
+
+  Burst fire (zero-cross mode): instead of one on-block per
+  window every mains half-wave is switched as a whole, the on
+  half-waves are spread evenly with a Bresenham accumulator.
+******************************************************/
+
+#ifndef _heaterWindow_H
+#define _heaterWindow_H
+
+#include <Arduino.h>
+
+class HeaterWindow
+{
+public:
+  static const uint32_t timerClockHz = 80000000; // APB clock of the ESP32 timers
+  static const uint16_t timerDivider = 80;       // 1 timer count = 1 us
+  static const uint32_t zeroCrossTimeoutUs = 50000; // no zero-cross for this long = detector or mains lost
+
+  // windowMs: length of one window, slots: wanted resolution per window
+  HeaterWindow(uint32_t windowMs, uint32_t slots)
+  {
+    uint64_t countsPerWindow = (uint64_t)windowMs * (timerClockHz / 1000) / timerDivider;
+    alarm = slots ? countsPerWindow / slots : countsPerWindow;
+    if (alarm == 0)
+    {
+      alarm = 1;
+    }
+    tickLength = (uint32_t)(alarm * timerDivider / (timerClockHz / 1000000)); // what the timer really does
+    windowSlots = (uint32_t)((uint64_t)windowMs * 1000 / tickLength);
+  }
+
+  uint64_t timerAlarm() const { return alarm; }
+  uint32_t tickUs() const { return tickLength; }
+  uint32_t slots() const { return windowSlots; }
+  uint32_t position() const { return slot; }
+
+  // control task: output in 0 ... outputMax, takes effect with the next window
+  void setOutput(float output, float outputMax)
+  {
+    if (output <= 0 || outputMax <= 0)
+    {
+      duty = 0;
+    }
+    else if (output >= outputMax)
+    {
+      duty = windowSlots << fractionBits;
+    }
+    else
+    {
+      duty = (uint32_t)(output / outputMax * (windowSlots << fractionBits) + 0.5f);
+    }
+  }
+
+  // switch off immediately, not only from the next window on
+  void stop()
+  {
+    duty = 0;
+    onSlots = 0;
+    remainder = 0;
+    accumulator = 0;
+  }
+
+  // timer ISR: true if the heater is on during the current slot
+  bool IRAM_ATTR tick()
+  {
+    if (slot == 0)
+    {
+      uint32_t total = duty + remainder;
+      onSlots = total >> fractionBits;
+      remainder = total & ((1 << fractionBits) - 1);
+    }
+    bool on = slot < onSlots;
+    if (++slot >= windowSlots)
+    {
+      slot = 0;
+    }
+    if (silence < zeroCrossTimeoutUs)
+    {
+      silence += tickLength;
+    }
+    return on;
+  }
+
+  // zero-cross ISR: true if the heater conducts during the half-wave that starts now
+  bool IRAM_ATTR halfWave()
+  {
+    silence = 0;
+    accumulator += duty;
+    uint32_t full = windowSlots << fractionBits;
+    if (accumulator >= full)
+    {
+      accumulator -= full;
+      return true;
+    }
+    return false;
+  }
+
+  // burst fire must not keep the heater on without zero-cross pulses
+  bool zeroCrossLost() const { return silence >= zeroCrossTimeoutUs; }
+
+private:
+  static const uint8_t fractionBits = 8; // duty in 1/256 slot
+
+  uint64_t alarm;
+  uint32_t tickLength;
+  uint32_t windowSlots;
+  volatile uint32_t duty = 0; // on-time per window in 1/256 slot
+  volatile uint32_t onSlots = 0;
+  volatile uint32_t remainder = 0;
+  volatile uint32_t slot = 0;
+  volatile uint32_t accumulator = 0;              // burst fire, in 1/256 slot
+  volatile uint32_t silence = zeroCrossTimeoutUs; // us since the last zero-cross
+};
+
+#endif // _heaterWindow_H
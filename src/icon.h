@@ -192,3 +192,34 @@ static const unsigned char PROGMEM blynk_NOK_u8g2[] = {
   B01000100,
   B10111100
 };
+
+// Large digits of the temperature readout, 7 segments of 2 px. Pre-rendered
+// in the u8g2 page layout: 2 pages of one byte per column (bit 0 = top), so a
+// digit is ORed into the frame buffer without going through a font.
+// 0...9, then '-'
+#define bigDigit_width 12
+#define bigDigit_height 16
+constexpr unsigned char PROGMEM bigDigit_bits[11][2][bigDigit_width] = {
+  {{0x7c, 0x7c, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x7c, 0x7c},
+   {0x3e, 0x3e, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0x3e, 0x3e}}, // 0
+  {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7c, 0x7c},
+   {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3e, 0x3e}}, // 1
+  {{0x00, 0x00, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x7c, 0x7c},
+   {0x3e, 0x3e, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0x00, 0x00}}, // 2
+  {{0x00, 0x00, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x7c, 0x7c},
+   {0x00, 0x00, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0x3e, 0x3e}}, // 3
+  {{0x7c, 0x7c, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x7c, 0x7c},
+   {0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x3e, 0x3e}}, // 4
+  {{0x7c, 0x7c, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x00, 0x00},
+   {0x00, 0x00, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0x3e, 0x3e}}, // 5
+  {{0x7c, 0x7c, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x00, 0x00},
+   {0x3e, 0x3e, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0x3e, 0x3e}}, // 6
+  {{0x00, 0x00, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x7c, 0x7c},
+   {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3e, 0x3e}}, // 7
+  {{0x7c, 0x7c, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x7c, 0x7c},
+   {0x3e, 0x3e, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0x3e, 0x3e}}, // 8
+  {{0x7c, 0x7c, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x83, 0x7c, 0x7c},
+   {0x00, 0x00, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0xc1, 0x3e, 0x3e}}, // 9
+  {{0x00, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00},
+   {0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00}}  // -
+};
@@ -9,7 +9,7 @@
 #include <EEPROM.h>
 #include "userConfig.h" // needs to be configured by the user
 #include <U8g2lib.h>
-#include "PID_v1.h"            //for PID calculation
+#include "boilerPID.h"         //for PID calculation
 #include <DallasTemperature.h> //Library for dallas temp sensor
 #include "TSIC.h"              //Library for TSIC temp sensor
 #if ESP8266
@@ -18,8 +18,22 @@
 #include <BlynkSimpleEsp32.h>
 #endif
 #include "icon.h" //user icons for display
+#include "controlState.h"
+#include "heaterWindow.h"
+#include "relayAutotune.h"
+#include "smithPredictor.h"
+#include "weightSampler.h"
+#include "shotRecorder.h"
+#include "pumpProfile.h"
+#include "stateMachine.h"
+#include "deadlineScheduler.h"
+#include "dirtyTiles.h"
+#include "displayView.h"
+#include "ringBuffer.h"
 #include "MQTT.h"
 #include <HX711.h>
+#include <SPIFFS.h>
+#include <atomic>
 
 /********************************************************
   DEFINES
@@ -39,9 +53,8 @@
 #define DEBUGSTART(a) Serial.begin(a);
 #endif
 
-#define pinRelayVentil 33 //Output pin for 3-way-valve
-#define pinRelayPumpe 32  //Output pin for pump
-#define pinRelayHeater 15 //Output pin for heater
+// relay, temperature sensor and display pins are in userConfig.h
+#define pinZeroCross 34   //Input pin for the zero-cross detector (HEATERMODE 1)
 
 #define pinClockWeightCellLeft 27      // Clock pin for left weight cell
 #define pinClockWeightCellRight 25     // Clock pin for right weight cell
@@ -50,14 +63,6 @@
 #define calibrationWeightCellLeft 170  // Calibration Value left
 #define calibrationWeightCellRight 170 // Calibration Value right
 
-#define OLED_RESET -1    //Output pin for dispaly reset pin
-#define OLED_SCL 22       //Output pin for dispaly clock pin
-#define OLED_SDA 21       //Output pin for dispaly data pin
-#define SCREEN_WIDTH 128 // OLED display width, in pixels
-#define SCREEN_HEIGHT 64 // OLED display height, in pixels
-
-#define ONE_WIRE_BUS 13 // Data wire is plugged into port 2 on the Arduino
-
 /********************************************************
    DISPLAY constructor, change if needed
 ******************************************************/
@@ -67,6 +72,18 @@ U8G2_SH1106_128X64_NONAME_F_HW_I2C u8g2(U8G2_R0); //e.g. 1.3"
 #else
 U8G2_SSD1306_128X64_NONAME_F_HW_I2C u8g2(U8G2_R0); //e.g. 0.96"
 #endif
+DirtyTiles displayTiles; // frames go out through displayTiles.send(u8g2), only the changed tiles
+
+// only the display task draws, loop() posts a DisplayView with showView()
+Seqlock<DisplayView> displayMailbox;
+TaskHandle_t displayTaskHandle = NULL;
+const BaseType_t displayTaskCore = 0;       // away from loop() and the control task
+const UBaseType_t displayTaskPriority = 1;  // below the WiFi/LwIP tasks on core 0
+const uint32_t displayTaskStackSize = 4096;
+std::atomic<uint32_t> displayFrames{0};     // frame time of the display task (core 0), draw and send,
+std::atomic<uint32_t> displayFrameUsSum{0}; // taken and reset by reportScheduler() (core 1)
+std::atomic<uint32_t> displayFrameUsMax{0};
+RingBuffer<GraphSample, 128> brewGraph;     // written by the graph job, read by the display task
 
 /********************************************************
   definitions below must be changed in the userConfig.h file
@@ -79,6 +96,8 @@ const int fallback = FALLBACK;
 const int triggerType = TRIGGERTYPE;
 const boolean ota = OTA;
 const int grafana = GRAFANA;
+const int heaterMode = HEATERMODE;
+const int pumpMode = PUMPMODE;
 const unsigned long wifiConnectionDelay = WIFICINNECTIONDELAY;
 const unsigned int maxWifiReconnects = MAXWIFIRECONNECTS;
 int machineLogo = MACHINELOGO;
@@ -160,6 +179,23 @@ double brewtimersoftware = 45; // 20-5 for detection
 double brewboarder = 150;      // border for the detection, be carefull: to low: risk of wrong brew detection and rising temperature
 const int PonE = PONE;
 
+/********************************************************
+   Feed-forward heater boost during brew, added on top of the
+   PID output from the start of the pump on, before the
+   sensor sees the cold water
+*****************************************************/
+struct BoostPoint
+{
+  unsigned long time; // ms since the start of the boost
+  double output;      // heater output added, 0...1000
+};
+const BoostPoint brewBoostProfile[] = {BREWBOOSTPROFILE};
+const int brewBoostPoints = sizeof(brewBoostProfile) / sizeof(brewBoostProfile[0]);
+int brewBoostON = BREWBOOST; // 1 = boost active, Blynk V42
+boolean brewBoostRunning = false;
+unsigned long brewBoostStart = 0;
+boolean brewSwitchClosed = false; // OnlyPID with hardware brew detection, for the edge
+
 /********************************************************
    Analog Input
 ******************************************************/
@@ -171,14 +207,31 @@ double totalbrewtime = 0;                           //total brewtime set in soft
 double preinfusion = 2000;                          //preinfusion time in ms
 double preinfusionpause = 5000;                     //preinfusion pause time in ms
 unsigned long bezugsZeit = 0;                       //total brewed time
-unsigned long startZeit = 0;                        //start time of brew
-const unsigned long analogreadingtimeinterval = 10; // ms
-unsigned long previousMillistempanalogreading;      // ms for analogreading
+const unsigned long analogreadingtimeinterval = 10; // ms, period of the control job
 
 /********************************************************
    Weight Cells
 ******************************************************/
 long targetWeight = 30.0;
+const unsigned long weightSettleTime = 3000; // ms after the pump stopped until the shot weight is final
+float stopLatency = 1.0;                     // s from the stop until the flow into the cup ends, learned per shot
+const float stopLatencyMax = 5.0;
+const float stopLatencyLearnRate = 0.3;      // share of the last shot in the learned latency
+const int stopLatencyAddress = 140;          // EEPROM
+float stopWeight = 0;                        // g, weight and flow when the shot was stopped by weight
+float stopFlow = 0;
+boolean stopLatencyPending = false;          // learn once the final weight is frozen
+
+/********************************************************
+   Shot recorder
+******************************************************/
+const int shotRecorderON = SHOTRECORDER;
+ShotRecorder shotRecorder(SHOTRECORDINTERVAL);
+const char *shotFile = "/shots.bin";
+const char *shotFileOld = "/shots.old";      // shotFile goes here when it is full
+const size_t shotFileMaxSize = 65536;
+boolean shotFileSystem = false;              // SPIFFS mounted
+unsigned long shotStopTime = 0;
 
 /********************************************************
    Sensor check
@@ -190,10 +243,9 @@ int maxErrorCounter = 10; //depends on intervaltempmes* , define max seconds for
 /********************************************************
    PID
 ******************************************************/
-unsigned long previousMillistemp; // initialisation at the end of init()
 const unsigned long intervaltempmestsic = 400;
 const unsigned long intervaltempmesds18b20 = 400;
-int pidMode = 1; //1 = Automatic, 0 = Manual
+int pidMode = 1; //1 = Automatic, 0 = Manual, 2 = relay autotune
 
 //volatile unsigned int interruptCounter;
 //int totalInterruptCounter;
@@ -201,9 +253,21 @@ int pidMode = 1; //1 = Automatic, 0 = Manual
 hw_timer_t *timer = NULL;
 portMUX_TYPE timerMux = portMUX_INITIALIZER_UNLOCKED;
 
-const unsigned int windowSize = 1000;
-volatile unsigned int isrCounter = 0; // counter for ISR
-//unsigned long windowStartTime;
+TaskHandle_t controlTaskHandle = NULL;        // control task, woken by the timer ISR
+const BaseType_t controlTaskCore = 1;         // same core as loop(), WiFi stays alone on core 0
+const UBaseType_t controlTaskPriority = 3;    // above loop() (1), below the WiFi/LwIP tasks
+const uint32_t controlTaskStackSize = 4096;
+
+const unsigned int windowSize = HEATERWINDOW; // ms, also the PID sample time
+const unsigned int outputMax = 1000;          // PID output range, 1000 = 100 % heater
+HeaterWindow heaterWindow(HEATERWINDOW, HEATERSLOTS);
+RelayAutotune autotune(AUTOTUNEOUTPUT, AUTOTUNEHYSTERESIS, AUTOTUNECYCLES, AUTOTUNETIMEOUT * 60000UL);
+SmithPredictor smithPredictor(MODELGAIN, MODELTIMECONSTANT, MODELDEADTIME, windowSize / 1000.0f); // only used by the control task
+int controller = CONTROLLER; // 0 = PID, 1 = PID with Smith predictor
+HeaterWindow pumpWindow(HEATERWINDOW, HEATERSLOTS); // PUMPMODE 1: pump power by skipping whole mains periods
+const ProfileSegment brewProfile[] = {BREWPROFILE};
+PumpProfile pumpProfile(heaterWindow.tickUs() / 1000, PROFILEFLOWGAIN); // stepped by the control task once per tick
+volatile boolean pumpSecondHalfWave = false;
 
 double Input, Output;
 double setPointTemp;
@@ -228,7 +292,192 @@ double aggKi = aggKp / aggTn;
 #endif
 double aggKd = aggTv * aggKp;
 
-PID bPID(&Input, &Output, &setPoint, aggKp, aggKi, aggKd, PonE, DIRECT); //PID initialisation
+float pidInput, pidOutput, pidSetPoint; // only used by the control task
+BoilerPID bPID(&pidInput, &pidOutput, &pidSetPoint, aggKp, aggKi, aggKd, PonE, DIRECT); //PID initialisation
+
+/********************************************************
+   Control state, loop() -> control task and back
+******************************************************/
+Seqlock<ControlState> controlRequest; // written by loop()
+Seqlock<ControlState> controlResult;  // written by the control task
+ControlState controlState = {0, SETPOINT, aggKp, aggKi, aggKd, PonE, AUTOMATIC, 0, 0, CONTROLLER, 0, PumpProfile::idle}; // what loop() wants
+ControlState controlFeedback = controlState;                                         // what the PID last ran with
+
+void startBrewBoost()
+{
+  if (brewBoostON == 0)
+    return;
+  brewBoostStart = millis();
+  brewBoostRunning = true;
+}
+
+// end or abort of the shot, no boost without water flowing
+void stopBrewBoost()
+{
+  brewBoostRunning = false;
+}
+
+// current boost, linear between the profile points, 0 before the first and after the last one
+double brewBoost()
+{
+  if (!brewBoostRunning)
+    return 0;
+
+  unsigned long elapsed = millis() - brewBoostStart;
+  if (elapsed < brewBoostProfile[0].time)
+    return 0;
+  for (int i = 1; i < brewBoostPoints; i++)
+  {
+    const BoostPoint &from = brewBoostProfile[i - 1];
+    const BoostPoint &to = brewBoostProfile[i];
+    if (elapsed < to.time)
+    {
+      return from.output + (to.output - from.output) * (elapsed - from.time) / (to.time - from.time);
+    }
+  }
+  brewBoostRunning = false;
+  return 0;
+}
+
+void publishControlState()
+{
+  controlState.input = Input;
+  controlState.setPoint = setPoint;
+  controlState.feedForward = brewBoost();
+  controlState.controller = controller;
+  controlRequest.write(controlState);
+}
+
+void fetchControlState()
+{
+  controlFeedback = controlResult.read();
+  Output = controlFeedback.output;
+}
+
+void setPump(boolean on)
+{
+  if (pumpMode == 1)
+  {
+    controlState.pump = on ? 1 : 0; // switched by onZeroCross()
+    publishControlState();
+  }
+  else
+  {
+    digitalWrite(pinRelayPumpe, on ? relayON : relayOFF);
+  }
+}
+
+void startPumpProfile()
+{
+  controlState.pump = 2;
+  publishControlState();
+}
+
+boolean pumpProfileDone()
+{
+  return controlFeedback.profileSegment >= pumpProfile.size();
+}
+
+void setPIDMode(int mode)
+{
+  controlState.mode = mode;
+  if (mode == MANUAL)
+  {
+    Output = 0;
+    controlState.output = 0;
+    portENTER_CRITICAL(&timerMux);
+    heaterWindow.stop(); // switch off right away, not only from the next window on
+    portEXIT_CRITICAL(&timerMux);
+  }
+  publishControlState();
+}
+
+void setPIDTunings(double kp, double ki, double kd, int pOn)
+{
+  controlState.kp = kp;
+  controlState.ki = ki;
+  controlState.kd = kd;
+  controlState.pOn = pOn;
+  publishControlState();
+}
+
+void setPIDTunings(double kp, double ki, double kd)
+{
+  setPIDTunings(kp, ki, kd, controlState.pOn);
+}
+
+// heater output in MANUAL mode, the PID starts from it when switched back to AUTOMATIC
+void setManualOutput(double output)
+{
+  controlState.output = output;
+  publishControlState();
+}
+
+/********************************************************
+  Relay autotune (pidMode 2)
+  The heater is switched by the autotune instead of the PID,
+  the new tunings go to aggKp/aggTn/aggTv, the eeprom and Blynk.
+*****************************************************/
+void startAutotune()
+{
+  if (pidMode == 2 || sensorError || emergencyStop || brewcounter > 10 || backflushState > 10)
+    return;
+
+  DEBUG_println("Autotune started");
+  pidMode = 2;
+  setPIDMode(MANUAL);
+  autotune.start(setPoint, millis());
+}
+
+void stopAutotune()
+{
+  autotune.stop();
+  pidMode = 0; // loop() switches back to automatic when it is safe
+  setPIDMode(MANUAL);
+}
+
+void runAutotune()
+{
+  if (brewcounter > 10 || timerBrewdetection == 1)
+  {
+    DEBUG_println("Autotune aborted, brew");
+    stopAutotune();
+    return;
+  }
+
+  setManualOutput(autotune.update(Input, millis()));
+
+  if (autotune.state() == RelayAutotune::DONE)
+  {
+    aggKp = autotune.kp();
+    aggTn = autotune.tn();
+    aggTv = autotune.tv();
+    DEBUG_print("Autotune done, Ku: ");
+    DEBUG_print(autotune.ultimateGain());
+    DEBUG_print(" Pu: ");
+    DEBUG_println(autotune.ultimatePeriod());
+
+    EEPROM.begin(1024);
+    EEPROM.put(0, aggKp);
+    EEPROM.put(10, aggTn);
+    EEPROM.put(20, aggTv);
+    EEPROM.commit();
+
+    // otherwise the next Blynk sync brings back the old values
+    if (Offlinemodus == 0)
+    {
+      Blynk.virtualWrite(V4, aggKp);
+      Blynk.virtualWrite(V5, aggTn);
+      Blynk.virtualWrite(V6, aggTv);
+    }
+    stopAutotune();
+  }
+  else if (autotune.state() == RelayAutotune::FAILED)
+  {
+    DEBUG_println("Autotune failed, timeout");
+    stopAutotune();
+  }
+}
 
 /********************************************************
    DALLAS TEMP
@@ -242,6 +491,12 @@ DeviceAddress sensorDeviceAddress;   // arrays to hold device address
 ******************************************************/
 HX711 weightCellLeft;
 HX711 weightCellRight;
+WeightSampler weightSampler(weightCellLeft, weightCellRight, WEIGHTPROCESSNOISE, WEIGHTMEASUREMENTNOISE, WEIGHTOUTLIERGATE);
+
+TaskHandle_t weightTaskHandle = NULL;      // sampler task, woken by the data ready interrupts
+const UBaseType_t weightTaskPriority = 2;  // below the control task, above loop()
+const uint32_t weightTaskStackSize = 2048;
+const TickType_t weightTaskTimeout = 250;  // ms, polls anyway if a data ready edge got lost
 
 /********************************************************
    Temp Sensors TSIC 306
@@ -254,13 +509,32 @@ float Temperatur_C = 0;     // internal variable that holds the converted temper
    BLYNK
 ******************************************************/
 //Update Intervall zur App
-unsigned long previousMillisBlynk; // initialisation at the end of init()
 const unsigned long intervalBlynk = 1000;
 int blynksendcounter = 1;
 
 //Update für Display
-unsigned long previousMillisDisplay; // initialisation at the end of init()
 const unsigned long intervalDisplay = 500;
+const unsigned long intervalBrewDisplay = 100; // brew screen, 10 fps
+const unsigned long intervalGraph = 500;       // one column of the brew graph, 120 columns = 60 s
+
+/********************************************************
+   Scheduler of the loop() jobs, added at the end of setup()
+******************************************************/
+DeadlineScheduler scheduler;
+const unsigned long intervalNetwork = 10;
+const unsigned long intervalSchedulerStats = 60000;
+
+void controlJob();
+
+// controlJob() steps the state machines, run it when the timed transition is due
+void runAtTransition(const StateMachine &machine)
+{
+  unsigned long next = machine.nextDeadline(millis());
+  if (next != StateMachine::noDeadline)
+  {
+    scheduler.runWithin(controlJob, next);
+  }
+}
 
 /********************************************************
    BLYNK define pins and read values
@@ -336,6 +610,17 @@ BLYNK_WRITE(V40)
 {
   backflushON = param.asInt();
 }
+BLYNK_WRITE(V41)
+{
+  if (param.asInt() == 1)
+  {
+    startAutotune();
+  }
+}
+BLYNK_WRITE(V42)
+{
+  brewBoostON = param.asInt();
+}
 
 #if (COLDSTART_PID == 2) // 2=?Blynk values, else default starttemp from config
 BLYNK_WRITE(V11)
@@ -408,12 +693,7 @@ void getSignalStrength()
 *****************************************************/
 void readAnalogInput()
 {
-  unsigned long currentMillistemp = millis();
-  if (currentMillistemp - previousMillistempanalogreading >= analogreadingtimeinterval)
-  {
-    previousMillistempanalogreading = currentMillistemp;
-    brewswitch = filter(analogRead(analogPin));
-  }
+  brewswitch = filter(analogRead(analogPin)); // every analogreadingtimeinterval, see brew()
 }
 
 /********************************************************
@@ -429,86 +709,83 @@ void testEmergencyStop()
   {
     emergencyStop = false;
   }
+
+  // safety ceiling of the relay autotune, well below the emergency stop
+  if (pidMode == 2 && (emergencyStop || Input > setPoint + AUTOTUNECEILING))
+  {
+    DEBUG_println("Autotune aborted, temperature above ceiling");
+    stopAutotune();
+  }
+}
+
+/********************************************************
+    Backflush state machine
+******************************************************/
+bool backflushSwitchOn() { return brewswitch > 1000 && backflushON; }
+bool backflushSwitchOff() { return brewswitch < 1000; }
+bool backflushCyclesDone() { return flushCycles >= maxflushCycles; }
+unsigned long backflushFillTime() { return FILLTIME; }
+unsigned long backflushFlushTime() { return flushTime; }
+
+void backflushFill()
+{
+  DEBUG_println("portafilter filling");
+  digitalWrite(pinRelayVentil, relayON);
+  setPump(true);
+}
+
+void backflushFlush()
+{
+  DEBUG_println("flushing");
+  digitalWrite(pinRelayVentil, relayOFF);
+  setPump(false);
+  flushCycles++;
+}
+
+void backflushFinished()
+{
+  DEBUG_println("backflush finished");
+  digitalWrite(pinRelayVentil, relayOFF);
+  setPump(false);
+  flushCycles = 0;
 }
 
+constexpr StateRow backflushStates[] = {
+    // state, entry, guard, next, timeout, deadline, timeoutNext, abortable
+    {10, backflushFinished, backflushSwitchOn, 20, nullptr, nullptr, 0, false}, // waiting for brew switch turning on
+    {20, backflushFill, nullptr, 0, backflushFillTime, nullptr, 30, true},      // portafilter filling
+    {30, backflushFlush, backflushCyclesDone, 43, backflushFlushTime, nullptr, 20, true}, // flushing
+    {43, nullptr, backflushSwitchOff, 10, nullptr, nullptr, 0, false},          // waiting for brew switch off position
+};
+static_assert(validStates(backflushStates), "backflush state table leads to an unknown state");
+StateMachine backflushMachine(backflushStates, backflushSwitchOff, 43);
+
 void backflush()
 {
   if (backflushState != 10 && backflushON == 0)
   {
-    backflushState = 43; // force reset in case backflushON is reset during backflush!
+    backflushMachine.jump(43, millis()); // force reset in case backflushON is reset during backflush!
+    backflushState = backflushMachine.state();
   }
   else if (Offlinemodus == 1 || brewcounter > 10 || maxflushCycles <= 0 || backflushON == 0)
   {
     return;
   }
 
-  if (pidMode == 1)
+  if (pidMode == 2)
+  { //Deactivate autotune, runAutotune() does not run during backflush
+    stopAutotune();
+  }
+  else if (pidMode == 1)
   { //Deactivate PID
     pidMode = 0;
-    bPID.SetMode(pidMode);
-    Output = 0;
+    setPIDMode(pidMode);
   }
   digitalWrite(pinRelayHeater, LOW); //Stop heating
 
-  readAnalogInput();
-
-  if (brewswitch < 1000 && backflushState > 10)
-  { //abort function for state machine from every state
-    backflushState = 43;
-  }
-
-  // state machine for brew
-  switch (backflushState)
-  {
-  case 10: // waiting step for brew switch turning on
-    if (brewswitch > 1000 && backflushON)
-    {
-      startZeit = millis();
-      backflushState = 20;
-    }
-    break;
-  case 20: //portafilter filling
-    DEBUG_println("portafilter filling");
-    digitalWrite(pinRelayVentil, relayON);
-    digitalWrite(pinRelayPumpe, relayON);
-    backflushState = 21;
-    break;
-  case 21: //waiting time for portafilter filling
-    if (millis() - startZeit > FILLTIME)
-    {
-      startZeit = millis();
-      backflushState = 30;
-    }
-    break;
-  case 30: //flushing
-    DEBUG_println("flushing");
-    digitalWrite(pinRelayVentil, relayOFF);
-    digitalWrite(pinRelayPumpe, relayOFF);
-    flushCycles++;
-    backflushState = 31;
-    break;
-  case 31: //waiting time for flushing
-    if (millis() - startZeit > flushTime && flushCycles < maxflushCycles)
-    {
-      startZeit = millis();
-      backflushState = 20;
-    }
-    else if (flushCycles >= maxflushCycles)
-    {
-      backflushState = 43;
-    }
-    break;
-  case 43: // waiting for brewswitch off position
-    if (brewswitch < 1000)
-    {
-      DEBUG_println("backflush finished");
-      digitalWrite(pinRelayVentil, relayOFF);
-      digitalWrite(pinRelayPumpe, relayOFF);
-      flushCycles = 0;
-      backflushState = 10;
-    }
-    break;
-  }
+  backflushMachine.step(millis()); // brew() has read the brew switch
+  backflushState = backflushMachine.state();
+  runAtTransition(backflushMachine);
 }
 
 /********************************************************
@@ -526,35 +803,103 @@ void u8g2_prepare(void)
   u8g2.setDisplayRotation(DISPALYROTATE);
 }
 
+/********************************************************
+  DISPLAY - hand a screen to the display task
+*****************************************************/
+void showView(const DisplayView &view)
+{
+  displayMailbox.write(view);
+  xTaskNotifyGive(displayTaskHandle);
+}
+
+void copyLine(char *line, const char *text)
+{
+  snprintf(line, DisplayView::lineLength, "%s", text);
+}
+
+DisplayView statusView(uint8_t screen)
+{
+  DisplayView view = DisplayView();
+  view.screen = screen;
+  view.input = Input;
+  view.setPoint = setPoint;
+  view.output = Output;
+  view.kp = controlFeedback.kp;
+  view.ki = controlFeedback.ki;
+  view.kd = controlFeedback.kd;
+  view.brewTime = bezugsZeit;
+  view.brewTimeLimit = ONLYPID == 1 ? brewtimersoftware : totalbrewtime / 1000;
+  view.brewTimeDigits = ONLYPID == 1 ? 0 : 2;
+  view.heaterPhase = heaterWindow.position() < heaterWindow.slots() / 2;
+  view.offline = Offlinemodus == 1;
+  if (!view.offline)
+  {
+    getSignalStrength();
+    view.wifiConnected = WiFi.status() == WL_CONNECTED;
+    view.bars = bars;
+    view.wifiReconnects = wifiReconnects;
+    view.blynkConnected = Blynk.connected();
+    view.mqtt = MQTT == 1;
+    view.mqttConnected = MQTT == 1 && client.connect("arduino", "try", "try");
+  }
+  return view;
+}
+
+DisplayView brewView()
+{
+  DisplayView view = DisplayView();
+  view.screen = DisplayView::BREW;
+  view.input = Input;
+  view.setPoint = setPoint;
+  view.brewTime = bezugsZeit;
+  view.weight = weightSampler.weight();
+  view.targetWeight = targetWeight;
+  return view;
+}
+
 /********************************************************
   DISPLAY - print message
 *****************************************************/
-void displayMessage(String text1, String text2, String text3, String text4, String text5, String text6)
+void displayMessage(const char *text1, const char *text2, const char *text3, const char *text4, const char *text5, const char *text6)
+{
+  DisplayView view = DisplayView();
+  view.screen = DisplayView::MESSAGE;
+  copyLine(view.text[0], text1);
+  copyLine(view.text[1], text2);
+  copyLine(view.text[2], text3);
+  copyLine(view.text[3], text4);
+  copyLine(view.text[4], text5);
+  copyLine(view.text[5], text6);
+  showView(view);
+}
+
+void drawMessage(const DisplayView &view)
 {
   u8g2.clearBuffer();
-  u8g2.setCursor(0, 0);
-  u8g2.print(text1);
-  u8g2.setCursor(0, 10);
-  u8g2.print(text2);
-  u8g2.setCursor(0, 20);
-  u8g2.print(text3);
-  u8g2.setCursor(0, 30);
-  u8g2.print(text4);
-  u8g2.setCursor(0, 40);
-  u8g2.print(text5);
-  u8g2.setCursor(0, 50);
-  u8g2.print(text6);
-  u8g2.sendBuffer();
+  for (uint8_t i = 0; i < DisplayView::lines; i++)
+  {
+    u8g2.setCursor(0, i * 10);
+    u8g2.print(view.text[i]);
+  }
 }
 
 /********************************************************
   DISPLAY - print logo and message at boot
 *****************************************************/
-void displayLogo(String displaymessagetext, String displaymessagetext2)
+void displayLogo(const char *displaymessagetext, const char *displaymessagetext2)
+{
+  DisplayView view = DisplayView();
+  view.screen = DisplayView::LOGO;
+  copyLine(view.text[0], displaymessagetext);
+  copyLine(view.text[1], displaymessagetext2);
+  showView(view);
+}
+
+void drawLogo(const DisplayView &view)
 {
   u8g2.clearBuffer();
-  u8g2.drawStr(0, 47, displaymessagetext.c_str());
-  u8g2.drawStr(0, 55, displaymessagetext2.c_str());
+  u8g2.drawStr(0, 47, view.text[0]);
+  u8g2.drawStr(0, 55, view.text[1]);
   //Rancilio startup logo
   if (machineLogo == 1)
   {
@@ -564,31 +909,35 @@ void displayLogo(String displaymessagetext, String displaymessagetext2)
   {
     u8g2.drawXBMP(0, 2, startLogoGaggia_width, startLogoGaggia_height, startLogoGaggia_bits);
   }
-  u8g2.sendBuffer();
 }
 
 /********************************************************
   DISPLAY - EmergencyStop
 *****************************************************/
 void displayEmergencyStop(void)
+{
+  showView(statusView(DisplayView::EMERGENCY));
+}
+
+void drawEmergencyStop(const DisplayView &view)
 {
   u8g2.clearBuffer();
   u8g2.drawXBMP(0, 0, logo_width, logo_height, logo_bits_u8g2); //draw temp icon
   u8g2.setCursor(32, 24);
   u8g2.print("Ist :  ");
-  u8g2.print(Input, 1);
+  u8g2.print(view.input, 1);
   u8g2.print(" ");
   u8g2.print((char)176);
   u8g2.print("C");
   u8g2.setCursor(32, 34);
   u8g2.print("Soll:  ");
-  u8g2.print(setPoint, 1);
+  u8g2.print(view.setPoint, 1);
   u8g2.print(" ");
   u8g2.print((char)176);
   u8g2.print("C");
 
   //draw current temp in icon
-  if (isrCounter < 500)
+  if (view.heaterPhase)
   {
     u8g2.drawLine(9, 48, 9, 5);
     u8g2.drawLine(10, 48, 10, 4);
@@ -598,7 +947,6 @@ void displayEmergencyStop(void)
     u8g2.setCursor(32, 4);
     u8g2.print("HEATING STOPPED");
   }
-  u8g2.sendBuffer();
 }
 
 /********************************************************
@@ -696,50 +1044,42 @@ boolean checkSensor(float tempInput)
 *****************************************************/
 void refreshTemp()
 {
-  unsigned long currentMillistemp = millis();
+  // runs every intervaltempmes*, see setup()
   previousInput = Input;
   if (TempSensor == 1)
   {
-    if (currentMillistemp - previousMillistemp >= intervaltempmesds18b20)
+    sensors.requestTemperatures();
+    if (!checkSensor(sensors.getTempCByIndex(0)) && firstreading == 0)
+      return; //if sensor data is not valid, abort function; Sensor must be read at least one time at system startup
+    Input = sensors.getTempCByIndex(0);
+    if (Brewdetection != 0)
     {
-      previousMillistemp = currentMillistemp;
-      sensors.requestTemperatures();
-      if (!checkSensor(sensors.getTempCByIndex(0)) && firstreading == 0)
-        return; //if sensor data is not valid, abort function; Sensor must be read at least one time at system startup
-      Input = sensors.getTempCByIndex(0);
-      if (Brewdetection != 0)
-      {
-        movAvg();
-      }
-      else if (firstreading != 0)
-      {
-        firstreading = 0;
-      }
+      movAvg();
+    }
+    else if (firstreading != 0)
+    {
+      firstreading = 0;
     }
   }
   if (TempSensor == 2)
   {
-    if (currentMillistemp - previousMillistemp >= intervaltempmestsic)
-    {
-      previousMillistemp = currentMillistemp;
-      /*  variable "temperature" must be set to zero, before reading new data
-            getTemperature only updates if data is valid, otherwise "temperature" will still hold old values
-      */
-      temperature = 0;
-      Sensor1.getTemperature(&temperature);
-      Temperatur_C = Sensor1.calc_Celsius(&temperature);
-      //Temperatur_C = random(130,131);
-      if (!checkSensor(Temperatur_C) && firstreading == 0)
-        return; //if sensor data is not valid, abort function; Sensor must be read at least one time at system startup
-      Input = Temperatur_C;
-      if (Brewdetection != 0)
-      {
-        movAvg();
-      }
-      else if (firstreading != 0)
-      {
-        firstreading = 0;
-      }
+    /*  variable "temperature" must be set to zero, before reading new data
+          getTemperature only updates if data is valid, otherwise "temperature" will still hold old values
+    */
+    temperature = 0;
+    Sensor1.getTemperature(&temperature);
+    Temperatur_C = Sensor1.calc_Celsius(&temperature);
+    //Temperatur_C = random(130,131);
+    if (!checkSensor(Temperatur_C) && firstreading == 0)
+      return; //if sensor data is not valid, abort function; Sensor must be read at least one time at system startup
+    Input = Temperatur_C;
+    if (Brewdetection != 0)
+    {
+      movAvg();
+    }
+    else if (firstreading != 0)
+    {
+      firstreading = 0;
     }
   }
 }
@@ -750,12 +1090,175 @@ void refreshTemp()
 
 bool targetWeightReached()
 {
-  long left = weightCellLeft.get_units();
-  long right = weightCellRight.get_units();
-  long currentWeight = (left + right);
-  Serial.println(currentWeight);
-  return (currentWeight >= targetWeight);
+  if (weightSampler.session() != WeightSampler::RUNNING)
+  {
+    return false; // 0 until the tare is through
+  }
+  // what is still on its way into the cup after the stop
+  WeightSample sample = weightSampler.latest(); // sampled by weightTask()
+  float flow = sample.flow > 0 ? sample.flow : 0;
+  if (sample.filtered < targetWeight - flow * stopLatency)
+  {
+    return false;
+  }
+  stopWeight = sample.filtered;
+  stopFlow = flow;
+  stopLatencyPending = true;
+  return true;
+};
+
+/********************************************************
+    End of a shot: pump stopped or brew switch off
+******************************************************/
+void endShot()
+{
+  weightSampler.stopSession(weightSettleTime);
+  shotRecorder.stop();
+  shotStopTime = millis();
+}
+
+/********************************************************
+    Write the recorded shot to flash, never while the pump runs
+******************************************************/
+void flushShot(boolean force)
+{
+  if (!shotRecorder.pending())
+  {
+    return;
+  }
+  // wait for the final weight, unless the scale stopped delivering or the next shot starts
+  if (!force && weightSampler.session() == WeightSampler::SETTLING && millis() - shotStopTime < 2 * weightSettleTime)
+  {
+    return;
+  }
+  if (!shotRecorder.flush(SPIFFS, shotFile, shotFileOld, shotFileMaxSize, weightSampler.weight()))
+  {
+    DEBUG_println("shot record not written");
+  }
+}
+
+/********************************************************
+    Learn the stop latency from the final weight of the shot
+******************************************************/
+void learnStopLatency()
+{
+  stopLatencyPending = false;
+  if (stopFlow < 0.2)
+  {
+    return; // cup removed or no flow at the stop, nothing to learn from
+  }
+  float shotLatency = (weightSampler.weight() - stopWeight) / stopFlow;
+  shotLatency = constrain(shotLatency, 0, stopLatencyMax);
+  float learned = stopLatency + stopLatencyLearnRate * (shotLatency - stopLatency);
+  DEBUG_print("stop latency: ");
+  DEBUG_println(learned);
+  if (fabs(learned - stopLatency) > 0.01)
+  {
+    stopLatency = learned;
+    EEPROM.begin(1024); // after the shot, no flash writes while the pump runs
+    EEPROM.put(stopLatencyAddress, stopLatency);
+    EEPROM.commit();
+  }
+}
+
+void loadStopLatency()
+{
+  float stored;
+  EEPROM.begin(1024);
+  EEPROM.get(stopLatencyAddress, stored);
+  if (!isnan(stored) && stored >= 0 && stored <= stopLatencyMax)
+  {
+    stopLatency = stored;
+  }
+}
+
+/********************************************************
+    Brew state machine, PUMPMODE 0: fixed times, 1: pump profile
+******************************************************/
+bool brewSwitchOn() { return brewswitch > 1000 && backflushState == 10 && backflushON == 0; }
+bool brewSwitchOff() { return brewswitch < 1000; }
+bool always() { return true; }
+bool brewProfileFinished() { return pumpProfileDone() || targetWeightReached(); }
+unsigned long preinfusionEnd() { return preinfusion; }
+unsigned long preinfusionPauseEnd() { return preinfusion + preinfusionpause; }
+unsigned long brewEnd() { return totalbrewtime; }
+
+void brewReady()
+{
+  digitalWrite(pinRelayVentil, relayOFF);
+  setPump(false);
+  bezugsZeit = 0;
+  brewDetected = 0; //rearm brewdetection
+}
+
+void brewStart()
+{
+  stopLatencyPending = false;
+  flushShot(true);              // last one still waits for its weight, the pump is still off
+  weightSampler.startSession(); // tare with the cup on the scale
+  if (shotRecorderON == 1 && shotFileSystem)
+  {
+    shotRecorder.start(setPoint);
+  }
+  kaltstart = false; // force reset kaltstart if shot is pulled
+  startBrewBoost();
+  digitalWrite(pinRelayVentil, relayON);
+  if (pumpMode == 1)
+  {
+    DEBUG_println("Pump profile");
+    startPumpProfile(); // preinfusion, pause and brew are segments of the profile
+  }
+  else
+  {
+    DEBUG_println("Preinfusion");
+    setPump(true);
+  }
+}
+
+void brewPause()
+{
+  DEBUG_println("preinfusion pause");
+  digitalWrite(pinRelayVentil, relayON);
+  setPump(false);
+}
+
+void brewRun()
+{
+  DEBUG_println("Brew started");
+  startBrewBoost();
+  digitalWrite(pinRelayVentil, relayON);
+  setPump(true);
+}
+
+void brewStop()
+{
+  DEBUG_println("Brew stopped");
+  digitalWrite(pinRelayVentil, relayOFF);
+  setPump(false);
+  stopBrewBoost();
+  endShot();
+}
+
+constexpr StateRow brewStates[] = {
+    // state, entry, guard, next, timeout, deadline, timeoutNext, abortable
+    {10, brewReady, brewSwitchOn, 20, nullptr, nullptr, 0, false},            // waiting for brew switch turning on
+    {20, brewStart, nullptr, 0, nullptr, preinfusionEnd, 30, true},           // preinfusion
+    {30, brewPause, nullptr, 0, nullptr, preinfusionPauseEnd, 40, true},      // preinfusion pause
+    {40, brewRun, targetWeightReached, 42, nullptr, brewEnd, 42, true},       // brew running
+    {42, brewStop, always, 43, nullptr, nullptr, 0, false},                   // brew finished
+    {43, nullptr, brewSwitchOff, 10, nullptr, nullptr, 0, false},             // waiting for brew switch off position
 };
+static_assert(validStates(brewStates), "brew state table leads to an unknown state");
+
+constexpr StateRow profileBrewStates[] = {
+    {10, brewReady, brewSwitchOn, 20, nullptr, nullptr, 0, false},
+    {20, brewStart, brewProfileFinished, 42, nullptr, nullptr, 0, true},      // pump profile running
+    {42, brewStop, always, 43, nullptr, nullptr, 0, false},
+    {43, nullptr, brewSwitchOff, 10, nullptr, nullptr, 0, false},
+};
+static_assert(validStates(profileBrewStates), "pump profile state table leads to an unknown state");
+
+StateMachine brewMachine = pumpMode == 1 ? StateMachine(profileBrewStates, brewSwitchOff, 42) : StateMachine(brewStates, brewSwitchOff, 42);
 
 /********************************************************
     PreInfusion, Brew , if not Only PID
@@ -767,89 +1270,42 @@ void brew()
     readAnalogInput();
     unsigned long currentMillistemp = millis();
 
-    if (brewswitch < 1000 && brewcounter > 10)
-    { //abort function for state machine from every state
-      brewcounter = 43;
-    }
-
-    if (brewcounter > 10)
+    if (stopLatencyPending && weightSampler.session() == WeightSampler::DONE)
     {
-      bezugsZeit = currentMillistemp - startZeit;
-      weightCellLeft.tare();
-      weightCellRight.tare();
+      learnStopLatency();
     }
 
+    flushShot(false);
+
     totalbrewtime = preinfusion + preinfusionpause + brewtime; // running every cycle, in case changes are done during brew
 
-    // state machine for brew
-    switch (brewcounter)
-    {
-    case 10: // waiting step for brew switch turning on
-      if (brewswitch > 1000 && backflushState == 10 && backflushON == 0)
-      {
-        startZeit = millis();
-        brewcounter = 20;
-        kaltstart = false; // force reset kaltstart if shot is pulled
-      }
-      else
-      {
-        backflush();
-      }
-      break;
-    case 20: //preinfusioon
-      DEBUG_println("Preinfusion");
-      digitalWrite(pinRelayVentil, relayON);
-      digitalWrite(pinRelayPumpe, relayON);
-      brewcounter = 21;
-      break;
-    case 21: //waiting time preinfusion
-      if (bezugsZeit > preinfusion)
-      {
-        brewcounter = 30;
-      }
-      break;
-    case 30: //preinfusion pause
-      DEBUG_println("preinfusion pause");
-      digitalWrite(pinRelayVentil, relayON);
-      digitalWrite(pinRelayPumpe, relayOFF);
-      brewcounter = 31;
-      break;
-    case 31: //waiting time preinfusion pause
-      if (bezugsZeit > preinfusion + preinfusionpause)
-      {
-        brewcounter = 40;
-      }
-      break;
-    case 40: //brew running
-      DEBUG_println("Brew started");
-      digitalWrite(pinRelayVentil, relayON);
-      digitalWrite(pinRelayPumpe, relayON);
-      brewcounter = 41;
-      break;
-    case 41: //waiting time brew
-      if ((bezugsZeit > totalbrewtime) || targetWeightReached())
-      {
-        brewcounter = 42;
-      }
-      break;
-    case 42: //brew finished
-      DEBUG_println("Brew stopped");
-      digitalWrite(pinRelayVentil, relayOFF);
-      digitalWrite(pinRelayPumpe, relayOFF);
-      brewcounter = 43;
-      break;
-    case 43: // waiting for brewswitch off position
-      if (brewswitch < 1000)
-      {
-        digitalWrite(pinRelayVentil, relayOFF);
-        digitalWrite(pinRelayPumpe, relayOFF);
-        currentMillistemp = 0;
-        bezugsZeit = 0;
-        brewDetected = 0; //rearm brewdetection
-        brewcounter = 10;
-      }
-      break;
+    brewMachine.step(currentMillistemp);
+    brewcounter = brewMachine.state();
+    runAtTransition(brewMachine);
+
+    if (brewcounter > 10)
+    {
+      bezugsZeit = brewMachine.elapsed(currentMillistemp);
+      shotRecorder.record(currentMillistemp, bezugsZeit, Input, Output, weightSampler.weight());
+    }
+    else
+    {
+      backflush();
+    }
+  }
+  else if (Brewdetection == 2)
+  {
+    // no pump control, the brew switch only starts the heater boost
+    readAnalogInput();
+    if (brewswitch > 1000 && !brewSwitchClosed)
+    {
+      startBrewBoost();
+    }
+    else if (brewswitch < 1000 && brewSwitchClosed)
+    {
+      stopBrewBoost();
     }
+    brewSwitchClosed = brewswitch > 1000;
   }
 }
 
@@ -914,7 +1370,9 @@ void checkWifi()
         DEBUG_println(wifiReconnects);
         if (!setupDone)
         {
-          displayMessage("", "", "", "", "Wifi reconnect:", String(wifiReconnects));
+          char reconnects[12];
+          snprintf(reconnects, sizeof(reconnects), "%u", wifiReconnects);
+          displayMessage("", "", "", "", "Wifi reconnect:", reconnects);
         }
         WiFi.disconnect();
         WiFi.begin(ssid, pass); // attempt to connect to Wifi network
@@ -958,331 +1416,936 @@ void checkBlynk()
   }
 }
 
+/********************************************************
+  DISPLAY - large digits of icon.h, ORed straight into the
+  page buffer, the top is on a page (8 rows)
+*****************************************************/
+const uint8_t bigDigitAdvance = bigDigit_width + 2;
+const uint8_t bigDotAdvance = 4;
+
+void drawBigGlyph(int16_t x, uint8_t page, const unsigned char (&glyph)[2][bigDigit_width])
+{
+  if (DISPALYROTATE == U8G2_R0)
+  {
+    // the buffer has the orientation of the screen
+    uint8_t *buffer = u8g2.getBufferPtr();
+    uint16_t pageWidth = u8g2.getBufferTileWidth() * 8;
+    for (uint8_t p = 0; p < 2; p++)
+    {
+      for (uint8_t c = 0; c < bigDigit_width; c++)
+      {
+        if (x + c >= 0 && x + c < pageWidth)
+        {
+          buffer[(page + p) * pageWidth + x + c] |= glyph[p][c];
+        }
+      }
+    }
+  }
+  else
+  {
+    // rotated, pixel by pixel through u8g2
+    for (uint8_t p = 0; p < 2; p++)
+    {
+      for (uint8_t c = 0; c < bigDigit_width; c++)
+      {
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+          if (glyph[p][c] & (1 << bit))
+          {
+            u8g2.drawPixel(x + c, (page + p) * 8 + bit);
+          }
+        }
+      }
+    }
+  }
+}
+
+// value with one decimal, returns the width
+int16_t drawBigNumber(int16_t x, uint8_t page, double value)
+{
+  char text[12];
+  snprintf(text, sizeof(text), "%.1f", value);
+  int16_t start = x;
+  for (const char *c = text; *c; c++)
+  {
+    if (*c >= '0' && *c <= '9')
+    {
+      drawBigGlyph(x, page, bigDigit_bits[*c - '0']);
+      x += bigDigitAdvance;
+    }
+    else if (*c == '-')
+    {
+      drawBigGlyph(x, page, bigDigit_bits[10]);
+      x += bigDigitAdvance;
+    }
+    else if (*c == '.')
+    {
+      u8g2.drawBox(x, page * 8 + bigDigit_height - 2, 2, 2);
+      x += bigDotAdvance;
+    }
+  }
+  return x - start;
+}
+
 /********************************************************
     send data to display
 ******************************************************/
 void printScreen()
 {
-  unsigned long currentMillisDisplay = millis();
-  if (currentMillisDisplay - previousMillisDisplay >= intervalDisplay)
-  {
-    previousMillisDisplay = currentMillisDisplay;
-    if (!sensorError)
-    {
-      u8g2.clearBuffer();
-      u8g2.drawXBMP(0, 0, logo_width, logo_height, logo_bits_u8g2); //draw temp icon
-      u8g2.setCursor(32, 14);
-      u8g2.print("Ist :  ");
-      u8g2.print(Input, 1);
-      u8g2.print(" ");
-      u8g2.print((char)176);
-      u8g2.print("C");
-      u8g2.setCursor(32, 24);
-      u8g2.print("Soll:  ");
-      u8g2.print(setPoint, 1);
-      u8g2.print(" ");
-      u8g2.print((char)176);
-      u8g2.print("C");
-
-      // Draw heat bar
-      u8g2.drawLine(15, 58, 117, 58);
-      u8g2.drawLine(15, 58, 15, 61);
-      u8g2.drawLine(117, 58, 117, 61);
-
-      u8g2.drawLine(16, 59, (Output / 10) + 16, 59);
-      u8g2.drawLine(16, 60, (Output / 10) + 16, 60);
-      u8g2.drawLine(15, 61, 117, 61);
-
-      //draw current temp in icon
-      if (fabs(Input - setPoint) < 0.3)
+  // runs every intervalDisplay, see displayJob()
+  if (!sensorError)
+  {
+    showView(statusView(DisplayView::STATUS));
+  }
+}
+
+void drawStatus(const DisplayView &view)
+{
+  u8g2.clearBuffer();
+  u8g2.drawXBMP(0, 0, logo_width, logo_height, logo_bits_u8g2); //draw temp icon
+  drawBigNumber(28, 2, view.input); // Ist, up to 86 for "120.0"
+  u8g2.setCursor(92, 14);            // Soll, "100.0" ends at 122
+  u8g2.print("Soll");
+  u8g2.setCursor(92, 23);
+  u8g2.print(view.setPoint, 1);
+
+  // Draw heat bar
+  u8g2.drawLine(15, 58, 117, 58);
+  u8g2.drawLine(15, 58, 15, 61);
+  u8g2.drawLine(117, 58, 117, 61);
+
+  u8g2.drawLine(16, 59, (view.output / 10) + 16, 59);
+  u8g2.drawLine(16, 60, (view.output / 10) + 16, 60);
+  u8g2.drawLine(15, 61, 117, 61);
+
+  //draw current temp in icon
+  if (fabs(view.input - view.setPoint) < 0.3)
+  {
+    if (view.heaterPhase)
+    {
+      u8g2.drawLine(9, 48, 9, 58 - (view.input / 2));
+      u8g2.drawLine(10, 48, 10, 58 - (view.input / 2));
+      u8g2.drawLine(11, 48, 11, 58 - (view.input / 2));
+      u8g2.drawLine(12, 48, 12, 58 - (view.input / 2));
+      u8g2.drawLine(13, 48, 13, 58 - (view.input / 2));
+    }
+  }
+  else if (view.input > 106)
+  {
+    u8g2.drawLine(9, 48, 9, 5);
+    u8g2.drawLine(10, 48, 10, 4);
+    u8g2.drawLine(11, 48, 11, 3);
+    u8g2.drawLine(12, 48, 12, 4);
+    u8g2.drawLine(13, 48, 13, 5);
+  }
+  else
+  {
+    u8g2.drawLine(9, 48, 9, 58 - (view.input / 2));
+    u8g2.drawLine(10, 48, 10, 58 - (view.input / 2));
+    u8g2.drawLine(11, 48, 11, 58 - (view.input / 2));
+    u8g2.drawLine(12, 48, 12, 58 - (view.input / 2));
+    u8g2.drawLine(13, 48, 13, 58 - (view.input / 2));
+  }
+
+  //draw setPoint line
+  u8g2.drawLine(18, 58 - (view.setPoint / 2), 23, 58 - (view.setPoint / 2));
+
+  // PID Werte ueber heatbar
+  u8g2.setCursor(40, 48);
+
+  u8g2.print(view.kp, 0); // P
+  u8g2.print("|");
+  if (view.ki != 0)
+  {
+    u8g2.print(view.kp / view.ki, 0);
+    ;
+  } // I
+  else
+  {
+    u8g2.print("0");
+  }
+  u8g2.print("|");
+  u8g2.print(view.kd / view.kp, 0); // D
+  u8g2.setCursor(98, 48);
+  if (view.output < 99)
+  {
+    u8g2.print(view.output / 10, 1);
+  }
+  else
+  {
+    u8g2.print(view.output / 10, 0);
+  }
+  u8g2.print("%");
+
+  // Brew
+  u8g2.setCursor(32, 34);
+  u8g2.print("Brew:  ");
+  u8g2.print(view.brewTime / 1000, 1);
+  u8g2.print("/");
+  u8g2.print(view.brewTimeLimit, view.brewTimeDigits); // brewtimersoftware with ONLYPID, else totalbrewtime
+  //draw box
+  u8g2.drawFrame(0, 0, 128, 64);
+
+  // Für Statusinfos
+  u8g2.drawFrame(32, 0, 84, 12);
+  if (!view.offline)
+  {
+    if (view.wifiConnected)
+    {
+      u8g2.drawXBMP(40, 2, 8, 8, antenna_OK_u8g2);
+      for (int b = 0; b <= view.bars; b++)
       {
-        if (isrCounter < 500)
-        {
-          u8g2.drawLine(9, 48, 9, 58 - (Input / 2));
-          u8g2.drawLine(10, 48, 10, 58 - (Input / 2));
-          u8g2.drawLine(11, 48, 11, 58 - (Input / 2));
-          u8g2.drawLine(12, 48, 12, 58 - (Input / 2));
-          u8g2.drawLine(13, 48, 13, 58 - (Input / 2));
-        }
+        u8g2.drawVLine(45 + (b * 2), 10 - (b * 2), b * 2);
       }
-      else if (Input > 106)
+    }
+    else
+    {
+      u8g2.drawXBMP(40, 2, 8, 8, antenna_NOK_u8g2);
+      u8g2.setCursor(88, 2);
+      u8g2.print("RC: ");
+      u8g2.print(view.wifiReconnects);
+    }
+    if (view.blynkConnected)
+    {
+      u8g2.drawXBMP(60, 2, 11, 8, blynk_OK_u8g2);
+    }
+    else
+    {
+      u8g2.drawXBMP(60, 2, 8, 8, blynk_NOK_u8g2);
+    }
+    if (view.mqtt)
+    {
+      if (view.mqttConnected)
       {
-        u8g2.drawLine(9, 48, 9, 5);
-        u8g2.drawLine(10, 48, 10, 4);
-        u8g2.drawLine(11, 48, 11, 3);
-        u8g2.drawLine(12, 48, 12, 4);
-        u8g2.drawLine(13, 48, 13, 5);
+        u8g2.setCursor(77, 2);
+        u8g2.print("MQTT");
       }
       else
       {
-        u8g2.drawLine(9, 48, 9, 58 - (Input / 2));
-        u8g2.drawLine(10, 48, 10, 58 - (Input / 2));
-        u8g2.drawLine(11, 48, 11, 58 - (Input / 2));
-        u8g2.drawLine(12, 48, 12, 58 - (Input / 2));
-        u8g2.drawLine(13, 48, 13, 58 - (Input / 2));
+        u8g2.setCursor(77, 2);
+        u8g2.print("");
       }
+    }
+  }
+  else
+  {
+    u8g2.setCursor(40, 2);
+    u8g2.print("Offlinemodus");
+  }
+}
+
+/********************************************************
+  DISPLAY - brew screen
+  The graph keeps its columns in the frame buffer between
+  frames: new samples shift it left and only their columns
+  are drawn, the text above is cleared and drawn every frame.
+*****************************************************/
+const uint8_t graphX = 4;
+const uint8_t graphWidth = 120;
+const uint8_t graphPage = 3; // pages 3...7
+const uint8_t graphTop = graphPage * 8;
+const uint8_t graphHeight = SCREEN_HEIGHT - graphTop;
+uint32_t graphDrawn = 0;     // display task: samples in the graph
+bool graphValid = false;     // false after another screen
+
+void sampleGraph()
+{
+  GraphSample sample;
+  sample.temperature = constrain((Input - setPoint) * 10 + 128, 0, 255);
+  sample.weight = constrain(weightSampler.weight() * 4, 0, 255);
+  brewGraph.push(sample);
+}
+
+uint8_t graphY(uint8_t value)
+{
+  return graphTop + graphHeight - 1 - value * (graphHeight - 1) / 255;
+}
+
+void drawGraphSpan(uint8_t x, uint8_t from, uint8_t to)
+{
+  u8g2.drawVLine(x, min(from, to), abs(from - to) + 1);
+}
+
+void drawGraphColumn(uint8_t x, uint32_t index)
+{
+  u8g2.setDrawColor(0);
+  u8g2.drawVLine(x, graphTop, graphHeight);
+  u8g2.setDrawColor(1);
+  if (index % 4 == 0)
+  {
+    u8g2.drawPixel(x, graphY(128)); // setPoint
+  }
+  GraphSample sample, previous;
+  if (!brewGraph.read(index, sample))
+  {
+    return;
+  }
+  if (!brewGraph.read(index - 1, previous))
+  {
+    previous = sample;
+  }
+  drawGraphSpan(x, graphY(previous.temperature), graphY(sample.temperature));
+  drawGraphSpan(x, graphY(previous.weight), graphY(sample.weight));
+}
+
+void drawBrewGraph()
+{
+  uint32_t count = brewGraph.count();
+  uint32_t fresh = count - graphDrawn;
+  if (!graphValid || fresh > graphWidth)
+  {
+    fresh = graphWidth;
+  }
+  else if (fresh > 0)
+  {
+    uint8_t *buffer = u8g2.getBufferPtr();
+    uint16_t pageWidth = u8g2.getBufferTileWidth() * 8;
+    for (uint8_t page = graphPage; page < u8g2.getBufferTileHeight(); page++)
+    {
+      uint8_t *row = buffer + page * pageWidth + graphX;
+      memmove(row, row + fresh, graphWidth - fresh);
+    }
+  }
+  for (uint32_t i = 0; i < fresh; i++)
+  {
+    drawGraphColumn(graphX + graphWidth - fresh + i, count - fresh + i);
+  }
+  graphDrawn = count;
+  graphValid = true;
+}
+
+void drawBrew(const DisplayView &view)
+{
+  if (!graphValid)
+  {
+    u8g2.clearBuffer();
+  }
+  u8g2.setDrawColor(0);
+  u8g2.drawBox(0, 0, SCREEN_WIDTH, graphTop);
+  u8g2.setDrawColor(1);
+  u8g2.setCursor(0, 0);
+  u8g2.print(view.brewTime / 1000.0, 1);
+  u8g2.print(" s");
+  u8g2.setCursor(64, 0);
+  u8g2.print(view.weight, 1);
+  u8g2.print("/");
+  u8g2.print(view.targetWeight, 0);
+  u8g2.print(" g");
+  u8g2.setCursor(0, 12);
+  u8g2.print(view.input, 1);
+  u8g2.print(" ");
+  u8g2.print((char)176);
+  u8g2.print("C");
+  u8g2.setCursor(64, 12);
+  u8g2.print("Soll ");
+  u8g2.print(view.setPoint, 1);
+  drawBrewGraph();
+}
 
-      //draw setPoint line
-      u8g2.drawLine(18, 58 - (setPoint / 2), 23, 58 - (setPoint / 2));
+/********************************************************
+  send data to Blynk server
+*****************************************************/
 
-      // PID Werte ueber heatbar
-      u8g2.setCursor(40, 48);
+void sendToBlynk()
+{
+  // runs every intervalBlynk, see setup()
+  if (Offlinemodus == 1)
+    return;
 
-      u8g2.print(bPID.GetKp(), 0); // P
-      u8g2.print("|");
-      if (bPID.GetKi() != 0)
+  //MQTT
+  if (MQTT == 1)
+  {
+    if (client.connect("arduino", "try", "try"))
+    {
+      DEBUG_println("MQTT connected");
+    }
+    else
+    {
+      DEBUG_println("MQTT connection failed");
+    }
+  }
+
+  if (Blynk.connected())
+  {
+    if (blynksendcounter == 1)
+    {
+      Blynk.virtualWrite(V2, Input);
+      //MQTT
+      if (MQTT == 1)
       {
-        u8g2.print(bPID.GetKp() / bPID.GetKi(), 0);
-        ;
-      } // I
-      else
+        char payload[16];
+        snprintf(payload, sizeof(payload), "%.2f", Input);
+        client.publish("/temp", payload);
+      }
+    }
+    if (blynksendcounter == 2)
+    {
+      Blynk.virtualWrite(V23, Output);
+    }
+    if (blynksendcounter == 3)
+    {
+      Blynk.virtualWrite(V7, setPoint);
+      //MQTT
+      if (MQTT == 1)
       {
-        u8g2.print("0");
+        char payload[16];
+        snprintf(payload, sizeof(payload), "%.2f", setPoint);
+        client.publish("/setPoint", payload);
       }
-      u8g2.print("|");
-      u8g2.print(bPID.GetKd() / bPID.GetKp(), 0); // D
-      u8g2.setCursor(98, 48);
-      if (Output < 99)
+    }
+    if (blynksendcounter == 4)
+    {
+      Blynk.virtualWrite(V35, heatrateaverage);
+    }
+    if (blynksendcounter == 5)
+    {
+      Blynk.virtualWrite(V36, heatrateaveragemin);
+    }
+    if (grafana == 1 && blynksendcounter >= 6)
+    {
+      Blynk.virtualWrite(V60, Input, Output, controlFeedback.kp, controlFeedback.ki, controlFeedback.kd, setPoint);
+      blynksendcounter = 0;
+    }
+    else if (grafana == 0 && blynksendcounter >= 5)
+    {
+      blynksendcounter = 0;
+    }
+    blynksendcounter++;
+  }
+}
+
+/********************************************************
+    Brewdetection
+******************************************************/
+void brewdetection()
+{
+  if (brewboarder == 0)
+    return; //abort brewdetection if deactivated
+
+  // Brew detecion == 1 software solution , == 2 hardware
+  if (Brewdetection == 1)
+  {
+    if (millis() - timeBrewdetection > brewtimersoftware * 1000)
+    {
+      timerBrewdetection = 0; //rearm brewdetection
+      if (OnlyPID == 1)
       {
-        u8g2.print(Output / 10, 1);
+        bezugsZeit = 0; // brewdetection is used in OnlyPID mode to detect a start of brew, and set the bezugsZeit
       }
-      else
+    }
+  }
+  else if (Brewdetection == 2)
+  {
+    if (millis() - timeBrewdetection > brewtimersoftware * 1000)
+    {
+      timerBrewdetection = 0; //rearm brewdetection
+    }
+  }
+
+  if (Brewdetection == 1)
+  {
+    if (heatrateaverage <= -brewboarder && timerBrewdetection == 0)
+    {
+      DEBUG_println("SW Brew detected");
+      timeBrewdetection = millis();
+      timerBrewdetection = 1;
+      if (OnlyPID == 1 && !brewBoostRunning)
       {
-        u8g2.print(Output / 10, 0);
+        startBrewBoost(); // late, but nothing else tells an OnlyPID machine about the brew
       }
-      u8g2.print("%");
-
-      // Brew
-      u8g2.setCursor(32, 34);
-      u8g2.print("Brew:  ");
-      u8g2.print(bezugsZeit / 1000, 1);
-      u8g2.print("/");
-      if (ONLYPID == 1)
+    }
+  }
+  else if (Brewdetection == 2)
+  {
+    if (brewcounter > 10 && brewDetected == 0 && brewboarder != 0)
+    {
+      DEBUG_println("HW Brew detected");
+      timeBrewdetection = millis();
+      timerBrewdetection = 1;
+      brewDetected = 1;
+    }
+  }
+}
+
+/********************************************************
+    Control task - PID calculation, woken by the timer ISR
+******************************************************/
+void controlTask(void *)
+{
+  ControlState state = controlRequest.read();
+  ControlState request;
+  bPID.SetTunings(state.kp, state.ki, state.kd, state.pOn);
+
+  int pump = 0;
+
+  for (;;)
+  {
+    uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // wait for the next timer tick, more if some were missed
+
+    // loop() may be halfway through publishing, then keep the last consistent request
+    if (controlRequest.tryRead(request))
+    {
+      if (request.kp != state.kp || request.ki != state.ki || request.kd != state.kd || request.pOn != state.pOn)
       {
-        u8g2.print(brewtimersoftware, 0); // deaktivieren wenn Preinfusion ( // voransetzen )
+        bPID.SetTunings(request.kp, request.ki, request.kd, request.pOn);
       }
-      else
+      if (request.mode != bPID.GetMode())
       {
-        u8g2.print(totalbrewtime / 1000); // aktivieren wenn Preinfusion
+        bPID.SetMode(request.mode); // to AUTOMATIC: starts from the last manual output
+        smithPredictor.reset();
       }
-      //draw box
-      u8g2.drawFrame(0, 0, 128, 64);
+      state = request;
+    }
+    pidInput = state.input;
+    if (state.controller == 1)
+    {
+      pidInput += smithPredictor.correction(); // what is already on its way to the sensor
+    }
+    pidSetPoint = state.setPoint;
 
-      // Für Statusinfos
-      u8g2.drawFrame(32, 0, 84, 12);
-      if (Offlinemodus == 0)
+    float heater;
+    if (state.mode == MANUAL)
+    {
+      pidOutput = constrain(state.output, 0, outputMax); // set by loop(): 0 = off, or the relay autotune
+      heater = pidOutput;
+    }
+    else
+    {
+      bool computed = bPID.Compute();
+      heater = constrain(pidOutput + state.feedForward, 0, outputMax); // brew boost, the PID does not see it
+      if (computed)
       {
-        getSignalStrength();
-        if (WiFi.status() == WL_CONNECTED)
-        {
-          u8g2.drawXBMP(40, 2, 8, 8, antenna_OK_u8g2);
-          for (int b = 0; b <= bars; b++)
-          {
-            u8g2.drawVLine(45 + (b * 2), 10 - (b * 2), b * 2);
-          }
-        }
-        else
-        {
-          u8g2.drawXBMP(40, 2, 8, 8, antenna_NOK_u8g2);
-          u8g2.setCursor(88, 2);
-          u8g2.print("RC: ");
-          u8g2.print(wifiReconnects);
-        }
-        if (Blynk.connected())
-        {
-          u8g2.drawXBMP(60, 2, 11, 8, blynk_OK_u8g2);
-        }
-        else
-        {
-          u8g2.drawXBMP(60, 2, 8, 8, blynk_NOK_u8g2);
-        }
-        if (MQTT == 1)
-        {
-          if (client.connect("arduino", "try", "try"))
-          {
-            u8g2.setCursor(77, 2);
-            u8g2.print("MQTT");
-          }
-          else
-          {
-            u8g2.setCursor(77, 2);
-            u8g2.print("");
-          }
-        }
+        smithPredictor.update(heater); // kept up to date with the PID as well, so it can be switched on any time
       }
-      else
+    }
+    heaterWindow.setOutput(heater, outputMax);
+
+    if (pumpMode == 1)
+    {
+      if (state.pump == 2 && pump != 2)
+      {
+        pumpProfile.start();
+      }
+      else if (state.pump != 2)
       {
-        u8g2.setCursor(40, 2);
-        u8g2.print("Offlinemodus");
+        pumpProfile.stop();
       }
-      u8g2.sendBuffer();
+      pump = state.pump;
+      float power = pump == 2 ? pumpProfile.step(ticks, weightSampler.weight(), weightSampler.latest().flow) : pump * outputMax;
+      pumpWindow.setOutput(power, outputMax);
+      state.profileSegment = pumpProfile.segment();
     }
+
+    state.output = heater;
+    controlResult.write(state);
   }
 }
 
 /********************************************************
-  send data to Blynk server
-*****************************************************/
+    Timer 1 - ISR for heat realay output, wakes the control task
+******************************************************/
+void IRAM_ATTR onTimer()
+{
 
-void sendToBlynk()
+  portENTER_CRITICAL_ISR(&timerMux);
+
+  //set PID output as relais commands
+  bool heaterOn = heaterWindow.tick();
+  if (heaterMode == 1)
+  {
+    if (heaterWindow.zeroCrossLost())
+    {
+      digitalWrite(pinRelayHeater, LOW); // burst fire is switched by onZeroCross(), but never without mains sync
+    }
+  }
+  else if (heaterOn)
+  {
+    digitalWrite(pinRelayHeater, HIGH);
+  }
+  else
+  {
+    digitalWrite(pinRelayHeater, LOW);
+  }
+
+  pumpWindow.tick();
+  if (pumpMode == 1 && pumpWindow.zeroCrossLost())
+  {
+    digitalWrite(pinRelayPumpe, relayOFF); // same for the pump
+  }
+
+  portEXIT_CRITICAL_ISR(&timerMux);
+
+  //run PID calculation in the control task
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(controlTaskHandle, &higherPriorityTaskWoken);
+  if (higherPriorityTaskWoken)
+  {
+    portYIELD_FROM_ISR();
+  }
+}
+
+/********************************************************
+    Zero-cross ISR - burst fire heater output (HEATERMODE 1)
+    and pump power (PUMPMODE 1)
+******************************************************/
+void IRAM_ATTR onZeroCross()
 {
-  if (Offlinemodus == 1)
-    return;
+  portENTER_CRITICAL_ISR(&timerMux);
+  if (heaterMode == 1)
+  {
+    if (heaterWindow.halfWave())
+    {
+      digitalWrite(pinRelayHeater, HIGH);
+    }
+    else
+    {
+      digitalWrite(pinRelayHeater, LOW);
+    }
+  }
+  if (pumpMode == 1)
+  {
+    // whole mains periods, the vibration pump only runs on one half-wave (diode)
+    pumpSecondHalfWave = !pumpSecondHalfWave;
+    if (!pumpSecondHalfWave)
+    {
+      digitalWrite(pinRelayPumpe, pumpWindow.halfWave() ? relayON : relayOFF);
+    }
+  }
+  portEXIT_CRITICAL_ISR(&timerMux);
+}
+
+/********************************************************
+    Weight task - reads the scales, woken by their data ready ISR
+******************************************************/
+void weightTask(void *)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(weightTaskTimeout));
+    weightSampler.poll();
+  }
+}
 
-  unsigned long currentMillisBlynk = millis();
+void IRAM_ATTR onWeightReady()
+{
+  // DOUT also toggles while a cell is read out, poll() ignores cells that are not ready
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(weightTaskHandle, &higherPriorityTaskWoken);
+  if (higherPriorityTaskWoken)
+  {
+    portYIELD_FROM_ISR();
+  }
+}
+
+//MQTT
+void messageReceived(MQTTClient *, char[], char bytes[], int length) // every topic sets the setPoint
+{
+  char payload[16]; // the payload is not terminated
+  length = constrain(length, 0, (int)sizeof(payload) - 1);
+  memcpy(payload, bytes, length);
+  payload[length] = '\0';
+  setPoint = atof(payload);
+}
+
+/********************************************************
+    Display task - draws the newest view and sends the changed
+    tiles, woken by showView()
+******************************************************/
+void displayTask(void *)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    unsigned long started = micros();
+    DisplayView view = displayMailbox.read();
+    if (view.screen != DisplayView::BREW)
+    {
+      graphValid = false; // the other screens clear the whole buffer
+    }
+    switch (view.screen)
+    {
+    case DisplayView::LOGO:
+      drawLogo(view);
+      break;
+    case DisplayView::MESSAGE:
+      drawMessage(view);
+      break;
+    case DisplayView::STATUS:
+      drawStatus(view);
+      break;
+    case DisplayView::EMERGENCY:
+      drawEmergencyStop(view);
+      break;
+    case DisplayView::BREW:
+      drawBrew(view);
+      break;
+    }
+    displayTiles.send(u8g2);
+
+    uint32_t frameUs = micros() - started;
+    displayFrameUsSum.fetch_add(frameUs, std::memory_order_relaxed);
+    displayFrames.fetch_add(1, std::memory_order_relaxed);
+    uint32_t frameUsMax = displayFrameUsMax.load(std::memory_order_relaxed);
+    while (frameUs > frameUsMax && !displayFrameUsMax.compare_exchange_weak(frameUsMax, frameUs, std::memory_order_relaxed))
+    {
+    }
+  }
+}
 
-  if (currentMillisBlynk - previousMillisBlynk >= intervalBlynk)
+/********************************************************
+  Jobs of loop(), the scheduler runs each one when it is due
+******************************************************/
+void networkJob()
+{
+  //Only do Wifi stuff, if Wifi is connected
+  if (WiFi.status() == WL_CONNECTED && Offlinemodus == 0)
   {
 
     //MQTT
     if (MQTT == 1)
     {
-      if (client.connect("arduino", "try", "try"))
-      {
-        DEBUG_println("MQTT connected");
-      }
-      else
-      {
-        DEBUG_println("MQTT connection failed");
-      }
+      client.loop();
     }
 
-    previousMillisBlynk = currentMillisBlynk;
+    ArduinoOTA.handle(); // For OTA
+    // Disable interrupt it OTA is starting, otherwise it will not work
+    ArduinoOTA.onStart([]() {
+      portENTER_CRITICAL_ISR(&timerMux);
+      digitalWrite(pinRelayHeater, LOW); //Stop heating
+    });
+    ArduinoOTA.onError([](ota_error_t) {
+      portEXIT_CRITICAL_ISR(&timerMux);
+    });
+    // Enable interrupts if OTA is finished
+    ArduinoOTA.onEnd([]() {
+      portEXIT_CRITICAL_ISR(&timerMux);
+    });
+
     if (Blynk.connected())
+    { // If connected run as normal
+      Blynk.run();
+      blynkReCnctCount = 0; //reset blynk reconnects if connected
+    }
+    else
     {
-      if (blynksendcounter == 1)
-      {
-        Blynk.virtualWrite(V2, Input);
-        //MQTT
-        if (MQTT == 1)
-        {
-          client.publish("/temp", String(Input));
-        }
-      }
-      if (blynksendcounter == 2)
+      checkBlynk();
+    }
+    wifiReconnects = 0; //reset wifi reconnects if connected
+  }
+  else
+  {
+    checkWifi();
+  }
+
+  //MQTT
+  if (MQTT == 1)
+  {
+    client.subscribe("/solltemp");
+    client.onMessageAdvanced(messageReceived); // no String per message
+  }
+}
+
+//Sicherheitsabfrage
+boolean normalOperation()
+{
+  return !sensorError && Input > 0 && !emergencyStop && backflushState == 10 && (backflushON == 0 || brewcounter > 10);
+}
+
+void controlJob()
+{
+  fetchControlState();   // Output and tunings of the last PID run
+  publishControlState(); // hand new Input and setPoint to the control task
+  testEmergencyStop();   // test if Temp is to high
+  brew();                //start brewing if button pressed
+
+  //check if PID should run or not. If not, set to manuel and force output to zero
+  if (pidON == 0 && pidMode == 2)
+  {
+    stopAutotune();
+  }
+  else if (pidON == 0 && pidMode == 1)
+  {
+    pidMode = 0;
+    setPIDMode(pidMode);
+  }
+  else if (pidON == 1 && pidMode == 0 && !sensorError && !emergencyStop && backflushState == 10)
+  {
+    pidMode = 1;
+    setPIDMode(pidMode);
+  }
+
+  if (normalOperation())
+  {
+    brewdetection(); //if brew detected, set PID values
+
+    if (pidMode == 2)
+    {
+      runAutotune(); // heater is driven by the autotune relay
+    }
+
+    //Set PID if first start of machine detected
+    if (Input < setPoint && kaltstart)
+    {
+      if (startTn != 0)
       {
-        Blynk.virtualWrite(V23, Output);
+        startKi = startKp / startTn;
       }
-      if (blynksendcounter == 3)
+      else
       {
-        Blynk.virtualWrite(V7, setPoint);
-        //MQTT
-        if (MQTT == 1)
-        {
-          client.publish("/setPoint", String(setPoint));
-        }
+        startKi = 0;
       }
-      if (blynksendcounter == 4)
+      setPIDTunings(startKp, startKi, 0, P_ON_M);
+    }
+    else if (timerBrewdetection == 0)
+    { //Prevent overwriting of brewdetection values
+      // calc ki, kd
+      if (aggTn != 0)
       {
-        Blynk.virtualWrite(V35, heatrateaverage);
+        aggKi = aggKp / aggTn;
       }
-      if (blynksendcounter == 5)
+      else
       {
-        Blynk.virtualWrite(V36, heatrateaveragemin);
+        aggKi = 0;
       }
-      if (grafana == 1 && blynksendcounter >= 6)
+      aggKd = aggTv * aggKp;
+      setPIDTunings(aggKp, aggKi, aggKd, PonE);
+      kaltstart = false;
+    }
+
+    if (millis() - timeBrewdetection < brewtimersoftware * 1000 && timerBrewdetection == 1)
+    {
+      // calc ki, kd
+      if (aggbTn != 0)
       {
-        Blynk.virtualWrite(V60, Input, Output, bPID.GetKp(), bPID.GetKi(), bPID.GetKd(), setPoint);
-        blynksendcounter = 0;
+        aggbKi = aggbKp / aggbTn;
       }
-      else if (grafana == 0 && blynksendcounter >= 5)
+      else
       {
-        blynksendcounter = 0;
+        aggbKi = 0;
       }
-      blynksendcounter++;
-    }
-  }
-}
-
-/********************************************************
-    Brewdetection
-******************************************************/
-void brewdetection()
-{
-  if (brewboarder == 0)
-    return; //abort brewdetection if deactivated
-
-  // Brew detecion == 1 software solution , == 2 hardware
-  if (Brewdetection == 1)
-  {
-    if (millis() - timeBrewdetection > brewtimersoftware * 1000)
-    {
-      timerBrewdetection = 0; //rearm brewdetection
+      aggbKd = aggbTv * aggbKp;
+      setPIDTunings(aggbKp, aggbKi, aggbKd);
       if (OnlyPID == 1)
       {
-        bezugsZeit = 0; // brewdetection is used in OnlyPID mode to detect a start of brew, and set the bezugsZeit
+        bezugsZeit = millis() - timeBrewdetection;
       }
     }
   }
-  else if (Brewdetection == 2)
+  else if (sensorError)
   {
-    if (millis() - timeBrewdetection > brewtimersoftware * 1000)
+
+    //Deactivate PID or autotune
+    if (pidMode == 2)
     {
-      timerBrewdetection = 0; //rearm brewdetection
+      stopAutotune();
     }
-  }
-
-  if (Brewdetection == 1)
-  {
-    if (heatrateaverage <= -brewboarder && timerBrewdetection == 0)
+    else if (pidMode == 1)
     {
-      DEBUG_println("SW Brew detected");
-      timeBrewdetection = millis();
-      timerBrewdetection = 1;
+      pidMode = 0;
+      setPIDMode(pidMode);
     }
+
+    digitalWrite(pinRelayHeater, LOW); //Stop heating
   }
-  else if (Brewdetection == 2)
+  else if (emergencyStop)
   {
-    if (brewcounter > 10 && brewDetected == 0 && brewboarder != 0)
+
+    //Deactivate PID or autotune
+    if (pidMode == 2)
     {
-      DEBUG_println("HW Brew detected");
-      timeBrewdetection = millis();
-      timerBrewdetection = 1;
-      brewDetected = 1;
+      stopAutotune();
     }
+    else if (pidMode == 1)
+    {
+      pidMode = 0;
+      setPIDMode(pidMode);
+    }
+
+    digitalWrite(pinRelayHeater, LOW); //Stop heating
   }
 }
 
-/********************************************************
-    Timer 1 - ISR for PID calculation and heat realay output
-******************************************************/
-void IRAM_ATTR onTimer()
+void displayJob()
 {
-
-  portENTER_CRITICAL_ISR(&timerMux);
-  //interruptCounter++;
-
-  if (Output <= isrCounter)
+  if (normalOperation())
   {
-    digitalWrite(pinRelayHeater, LOW);
-    //DEBUG_println("Power off!");
+    if (brewcounter <= 10)
+    {
+      printScreen(); // brewScreen() while brewing
+    }
   }
-  else
+  else if (sensorError)
   {
-    digitalWrite(pinRelayHeater, HIGH);
-    //DEBUG_println("Power on!");
+    char temperature[16];
+    snprintf(temperature, sizeof(temperature), "%.2f", Input);
+    displayMessage("Error, Temp: ", temperature, "Check Temp. Sensor!", "", "", ""); //DISPLAY AUSGABE
   }
-
-  isrCounter += 10; // += 10 because one tick = 10ms
-  //set PID output as relais commands
-  if (isrCounter > windowSize)
+  else if (emergencyStop)
   {
-    isrCounter = 0;
+    displayEmergencyStop();
   }
+  else if (backflushON || backflushState > 10)
+  {
+    if (backflushState == 43)
+    {
+      displayMessage("Backflush finished", "Please reset brewswitch...", "", "", "", "");
+    }
+    else if (backflushState == 10)
+    {
+      displayMessage("Backflush activated", "Please set brewswitch...", "", "", "", "");
+    }
+    else if (backflushState > 10)
+    {
+      char cycles[12], maxCycles[12];
+      snprintf(cycles, sizeof(cycles), "%d", flushCycles);
+      snprintf(maxCycles, sizeof(maxCycles), "%d", maxflushCycles);
+      displayMessage("Backflush running:", cycles, "from", maxCycles, "", "");
+    }
+  }
+}
 
-  //run PID calculation
-  bPID.Compute();
-
-  timerAlarmWrite(timer, 6250, true);
-
-  portEXIT_CRITICAL_ISR(&timerMux);
+void brewScreen()
+{
+  // runs every intervalBrewDisplay, printScreen() pauses meanwhile
+  if (brewcounter > 10 && normalOperation())
+  {
+    showView(brewView());
+  }
 }
 
-//MQTT
-void messageReceived(String &topic, String &payload)
+void reportScheduler()
 {
-  //DEBUG_println("incoming: " + topic + " - " + payload);
-  setPoint = payload.toDouble();
+  for (uint8_t i = 0; i < scheduler.size(); i++)
+  {
+    const DeadlineScheduler::Job &job = scheduler.job(i);
+    DEBUG_print(job.name);
+    DEBUG_print(": late us mean ");
+    DEBUG_print(scheduler.lateMean(i));
+    DEBUG_print(" max ");
+    DEBUG_print(job.lateMax);
+    DEBUG_print(", run us max ");
+    DEBUG_println(job.runMax);
+  }
+  DEBUG_print("idle % ");
+  DEBUG_println(scheduler.idlePercent());
+  scheduler.resetStats();
+
+  // swapped out, a frame that ends meanwhile counts in the next report
+  uint32_t frames = displayFrames.exchange(0, std::memory_order_relaxed);
+  uint32_t frameUsSum = displayFrameUsSum.exchange(0, std::memory_order_relaxed);
+  uint32_t frameUsMax = displayFrameUsMax.exchange(0, std::memory_order_relaxed);
+  DEBUG_print("display frames ");
+  DEBUG_print(frames);
+  DEBUG_print(", frame us mean ");
+  DEBUG_print(frames ? frameUsSum / frames : 0);
+  DEBUG_print(" max ");
+  DEBUG_println(frameUsMax);
+
+  // a steady state that allocates nothing keeps both constant
+  DEBUG_print("heap free ");
+  DEBUG_print(ESP.getFreeHeap());
+  DEBUG_print(" min ");
+  DEBUG_println(ESP.getMinFreeHeap());
 }
 
 void setup()
@@ -1324,6 +2387,7 @@ void setup()
   ******************************************************/
   u8g2.begin();
   u8g2_prepare();
+  xTaskCreatePinnedToCore(displayTask, "display", displayTaskStackSize, NULL, displayTaskPriority, &displayTaskHandle, displayTaskCore);
   displayLogo(sysVersion, "");
   delay(2000);
 
@@ -1446,8 +2510,9 @@ void setup()
   ******************************************************/
 
   setPointTemp = setPoint;
+  pidSetPoint = setPoint;
   bPID.SetSampleTime(windowSize);
-  bPID.SetOutputLimits(0, windowSize);
+  bPID.SetOutputLimits(0, outputMax);
   bPID.SetMode(AUTOMATIC);
 
   /********************************************************
@@ -1483,6 +2548,24 @@ void setup()
   // set the scales to 0
   weightCellLeft.tare();
   weightCellRight.tare();
+  loadStopLatency();
+
+  if (!pumpProfile.compile(brewProfile, sizeof(brewProfile) / sizeof(brewProfile[0])))
+  {
+    DEBUG_println("BREWPROFILE has too many segments");
+  }
+
+  if (shotRecorderON == 1)
+  {
+    shotFileSystem = SPIFFS.begin(true); // formats the partition on first use
+  }
+
+  // from now on only the weight task reads the scales
+  xTaskCreatePinnedToCore(weightTask, "weight", weightTaskStackSize, NULL, weightTaskPriority, &weightTaskHandle, controlTaskCore);
+  pinMode(pinDataWeightCellLeft, INPUT);
+  pinMode(pinDataWeightCellRight, INPUT);
+  attachInterrupt(digitalPinToInterrupt(pinDataWeightCellLeft), onWeightReady, FALLING);
+  attachInterrupt(digitalPinToInterrupt(pinDataWeightCellRight), onWeightReady, FALLING);
 
   /********************************************************
     movingaverage ini array
@@ -1503,23 +2586,36 @@ void setup()
     Input = Sensor1.calc_Celsius(&temperature);
   }
 
-  //Initialisation MUST be at the very end of the init(), otherwise the time comparision in loop() will have a big offset
-  unsigned long currentTime = millis();
-  previousMillistemp = currentTime;
-  //windowStartTime = currentTime;
-  previousMillisDisplay = currentTime;
-  previousMillisBlynk = currentTime;
+  //Initialisation MUST be at the very end of the init(), otherwise the first deadlines of loop() will have a big offset
+  scheduler.add("control", analogreadingtimeinterval, controlJob);
+  scheduler.add("network", intervalNetwork, networkJob);
+  scheduler.add("temp", TempSensor == 1 ? intervaltempmesds18b20 : intervaltempmestsic, refreshTemp);
+  scheduler.add("blynk", intervalBlynk, sendToBlynk);
+  scheduler.add("display", intervalDisplay, displayJob);
+  scheduler.add("brew screen", intervalBrewDisplay, brewScreen);
+  scheduler.add("graph", intervalGraph, sampleGraph);
+#ifdef DEBUGMODE
+  scheduler.add("stats", intervalSchedulerStats, reportScheduler);
+#endif
 
   /********************************************************
     Timer ISR - Initialisierung
-    TIM_DIV1 = 0,   //80MHz (80 ticks/us - 104857.588 us max)
-    TIM_DIV16 = 1,  //5MHz (5 ticks/us - 1677721.4 us max)
-    TIM_DIV256 = 3  //312.5Khz (1 tick = 3.2us - 26843542.4 us max)
+    Divider 80 -> 1MHz (1 tick = 1us), the alarm fires once per heater slot:
+    HEATERWINDOW / HEATERSLOTS ms, 10ms by default
   ******************************************************/
-  timer = timerBegin(0, 256, true);
+  publishControlState();
+  xTaskCreatePinnedToCore(controlTask, "control", controlTaskStackSize, NULL, controlTaskPriority, &controlTaskHandle, controlTaskCore);
+
+  timer = timerBegin(0, HeaterWindow::timerDivider, true);
   timerAttachInterrupt(timer, &onTimer, true);
-  timerAlarmWrite(timer, 6250, true);
+  timerAlarmWrite(timer, heaterWindow.timerAlarm(), true);
   timerAlarmEnable(timer);
+
+  if (heaterMode == 1 || pumpMode == 1)
+  {
+    pinMode(pinZeroCross, INPUT);
+    attachInterrupt(digitalPinToInterrupt(pinZeroCross), onZeroCross, RISING);
+  }
   /*
   timer1_attachInterrupt(onTimer1ISR);
   //timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
@@ -1532,169 +2628,5 @@ void setup()
 
 void loop()
 {
-  //Only do Wifi stuff, if Wifi is connected
-  if (WiFi.status() == WL_CONNECTED && Offlinemodus == 0)
-  {
-
-    //MQTT
-    if (MQTT == 1)
-    {
-      client.loop();
-    }
-
-    ArduinoOTA.handle(); // For OTA
-    // Disable interrupt it OTA is starting, otherwise it will not work
-    ArduinoOTA.onStart([]() {
-      portENTER_CRITICAL_ISR(&timerMux);
-      digitalWrite(pinRelayHeater, LOW); //Stop heating
-    });
-    ArduinoOTA.onError([](ota_error_t error) {
-      portEXIT_CRITICAL_ISR(&timerMux);
-    });
-    // Enable interrupts if OTA is finished
-    ArduinoOTA.onEnd([]() {
-      portEXIT_CRITICAL_ISR(&timerMux);
-    });
-
-    if (Blynk.connected())
-    { // If connected run as normal
-      Blynk.run();
-      blynkReCnctCount = 0; //reset blynk reconnects if connected
-    }
-    else
-    {
-      checkBlynk();
-    }
-    wifiReconnects = 0; //reset wifi reconnects if connected
-  }
-  else
-  {
-    checkWifi();
-  }
-
-  //MQTT
-  if (MQTT == 1)
-  {
-    client.subscribe("/solltemp");
-    client.onMessage(messageReceived);
-  }
-
-  refreshTemp();       //read new temperature values
-  testEmergencyStop(); // test if Temp is to high
-  brew();              //start brewing if button pressed
-
-  sendToBlynk();
-
-  //check if PID should run or not. If not, set to manuel and force output to zero
-  if (pidON == 0 && pidMode == 1)
-  {
-    pidMode = 0;
-    bPID.SetMode(pidMode);
-    Output = 0;
-  }
-  else if (pidON == 1 && pidMode == 0 && !sensorError && !emergencyStop && backflushState == 10)
-  {
-    pidMode = 1;
-    bPID.SetMode(pidMode);
-  }
-
-  //Sicherheitsabfrage
-  if (!sensorError && Input > 0 && !emergencyStop && backflushState == 10 && (backflushON == 0 || brewcounter > 10))
-  {
-    brewdetection(); //if brew detected, set PID values
-    printScreen();   // refresh display
-
-    //Set PID if first start of machine detected
-    if (Input < setPoint && kaltstart)
-    {
-      if (startTn != 0)
-      {
-        startKi = startKp / startTn;
-      }
-      else
-      {
-        startKi = 0;
-      }
-      bPID.SetTunings(startKp, startKi, 0, P_ON_M);
-    }
-    else if (timerBrewdetection == 0)
-    { //Prevent overwriting of brewdetection values
-      // calc ki, kd
-      if (aggTn != 0)
-      {
-        aggKi = aggKp / aggTn;
-      }
-      else
-      {
-        aggKi = 0;
-      }
-      aggKd = aggTv * aggKp;
-      bPID.SetTunings(aggKp, aggKi, aggKd, PonE);
-      kaltstart = false;
-    }
-
-    if (millis() - timeBrewdetection < brewtimersoftware * 1000 && timerBrewdetection == 1)
-    {
-      // calc ki, kd
-      if (aggbTn != 0)
-      {
-        aggbKi = aggbKp / aggbTn;
-      }
-      else
-      {
-        aggbKi = 0;
-      }
-      aggbKd = aggbTv * aggbKp;
-      bPID.SetTunings(aggbKp, aggbKi, aggbKd);
-      if (OnlyPID == 1)
-      {
-        bezugsZeit = millis() - timeBrewdetection;
-      }
-    }
-  }
-  else if (sensorError)
-  {
-
-    //Deactivate PID
-    if (pidMode == 1)
-    {
-      pidMode = 0;
-      bPID.SetMode(pidMode);
-      Output = 0;
-    }
-
-    digitalWrite(pinRelayHeater, LOW); //Stop heating
-
-    displayMessage("Error, Temp: ", String(Input), "Check Temp. Sensor!", "", "", ""); //DISPLAY AUSGABE
-  }
-  else if (emergencyStop)
-  {
-
-    //Deactivate PID
-    if (pidMode == 1)
-    {
-      pidMode = 0;
-      bPID.SetMode(pidMode);
-      Output = 0;
-    }
-
-    digitalWrite(pinRelayHeater, LOW); //Stop heating
-
-    displayEmergencyStop();
-  }
-  else if (backflushON || backflushState > 10)
-  {
-    if (backflushState == 43)
-    {
-      displayMessage("Backflush finished", "Please reset brewswitch...", "", "", "", "");
-    }
-    else if (backflushState == 10)
-    {
-      displayMessage("Backflush activated", "Please set brewswitch...", "", "", "", "");
-    }
-    else if (backflushState > 10)
-    {
-      displayMessage("Backflush running:", String(flushCycles), "from", String(maxflushCycles), "", "");
-    }
-  }
+  scheduler.run(); // sleeps until the next job is due
 }
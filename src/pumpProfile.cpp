@@ -0,0 +1,79 @@
+/********************************************************
+  PumpProfile - pump power or flow over the shot
+******************************************************/
+
+#include "pumpProfile.h"
+
+PumpProfile::PumpProfile(uint32_t tickMs, float flowGain)
+    : tickMs(tickMs ? tickMs : 1), flowGain(flowGain)
+{
+}
+
+bool PumpProfile::compile(const ProfileSegment *segments, uint8_t count)
+{
+  if (count > maxSteps)
+  {
+    return false;
+  }
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const ProfileSegment &segment = segments[i];
+    Step &step = steps[i];
+    // power in % and flow in g/s both become 1/1000
+    float scale = segment.type == POWER ? 10 : 1000;
+    step.type = segment.type;
+    step.untilWeight = segment.untilWeight > 0 ? (uint16_t)(segment.untilWeight * 10 + 0.5f) : 0;
+    step.ticks = (segment.duration + tickMs / 2) / tickMs;
+    step.start = (int32_t)(segment.start * scale * 65536);
+    step.slope = step.ticks ? (int32_t)((segment.end - segment.start) * scale * 65536 / step.ticks) : 0;
+  }
+  this->count = count;
+  return true;
+}
+
+void PumpProfile::start()
+{
+  index = 0;
+  tick = 0;
+  power = 0;
+}
+
+void PumpProfile::stop()
+{
+  index = idle;
+  power = 0;
+}
+
+float PumpProfile::step(uint32_t ticks, float weight, float flow)
+{
+  // next step once the time is over or the weight is in the cup
+  while (index >= 0 && index < count)
+  {
+    const Step &step = steps[index];
+    if (tick < step.ticks && (step.untilWeight == 0 || weight * 10 < step.untilWeight))
+    {
+      break;
+    }
+    index++;
+    tick = 0;
+  }
+  if (index < 0 || index >= count)
+  {
+    power = 0;
+    return power;
+  }
+
+  const Step &step = steps[index];
+  float target = (step.start + (int64_t)step.slope * tick) / 65536.0f;
+  tick += ticks;
+  if (step.type == POWER)
+  {
+    power = target;
+  }
+  else
+  {
+    power += flowGain * (target / 1000 - flow) * ticks * tickMs / 1000;
+  }
+  power = power < 0 ? 0 : power > 1000 ? 1000 : power;
+  return power;
+}
@@ -0,0 +1,74 @@
+/********************************************************
+  PumpProfile - pump power or flow over the shot
+  A profile is a list of segments, each one ramps the pump
+  power (0...100 %) or the flow into the cup (g/s) linearly
+  from start to end over its duration, and ends early once
+  the cup holds untilWeight (0 = never). At setup the list is
+  compiled into a table of fixed point steps in control task
+  ticks, so the control task only counts ticks and adds up
+  the slope. Flow segments close the loop over the
+  weight cells: the pump power follows the flow error with
+  an integral controller, starting from the power before.
+******************************************************/
+
+#ifndef _pumpProfile_H
+#define _pumpProfile_H
+
+#include <stdint.h>
+
+struct ProfileSegment
+{
+  uint8_t type;        // PumpProfile::POWER or PumpProfile::FLOW
+  float start;         // % or g/s
+  float end;
+  uint32_t duration;   // ms
+  float untilWeight;   // g, 0 = until the duration is over
+};
+
+class PumpProfile
+{
+public:
+  enum Type
+  {
+    POWER,
+    FLOW
+  };
+  static const uint8_t maxSteps = 16;
+  static const int8_t idle = -1;
+
+  // tickMs: time between two step() calls, flowGain: power (0...1000) per g/s of flow error and s
+  PumpProfile(uint32_t tickMs, float flowGain);
+
+  // setup only, false if the list does not fit
+  bool compile(const ProfileSegment *segments, uint8_t count);
+  uint8_t size() const { return count; }
+
+  void start();
+  void stop();
+
+  // control task: ticks since the last call, weight in the cup and flow, returns the pump power 0...1000
+  float step(uint32_t ticks, float weight, float flow);
+
+  // segment running, idle before start() and after stop(), size() once all are through
+  int8_t segment() const { return index; }
+
+private:
+  struct Step
+  {
+    uint8_t type;
+    uint16_t untilWeight; // 1/10 g, 0 = none
+    uint32_t ticks;
+    int32_t start;        // power in 1/1000 or flow in 1/1000 g/s, << 16
+    int32_t slope;        // per tick, << 16
+  };
+
+  uint32_t tickMs;
+  float flowGain;
+  Step steps[maxSteps];
+  uint8_t count = 0;
+  int8_t index = idle;
+  uint32_t tick = 0;      // within the current step
+  float power = 0;
+};
+
+#endif // _pumpProfile_H
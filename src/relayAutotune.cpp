@@ -0,0 +1,102 @@
+/********************************************************
+  RelayAutotune - relay feedback autotune (Astrom-Hagglund)
+******************************************************/
+
+#include <math.h>
+#include "relayAutotune.h"
+
+RelayAutotune::RelayAutotune(float outputHigh, float hysteresis, unsigned cycles, unsigned long timeoutMs)
+    : outputHigh(outputHigh), hysteresis(hysteresis), cycles(cycles ? cycles : 1), timeout(timeoutMs)
+{
+}
+
+void RelayAutotune::start(float setPoint, unsigned long now)
+{
+  this->setPoint = setPoint;
+  currentState = RUNNING;
+  relayOn = true;
+  started = now;
+  lastOn = now;
+  peakHigh = -INFINITY;
+  peakLow = INFINITY;
+  switches = 0;
+  amplitudeSum = 0;
+  periodSum = 0;
+  measured = 0;
+}
+
+void RelayAutotune::stop()
+{
+  if (currentState == RUNNING)
+  {
+    currentState = IDLE;
+  }
+}
+
+/********************************************************
+  The maximum of the temperature is reached after the relay
+  switched off (dead time and lag), the minimum after it
+  switched on, so one period runs from switch on to switch
+  on and holds one of each. The first period starts from
+  wherever the boiler was and is not measured.
+******************************************************/
+float RelayAutotune::update(float input, unsigned long now)
+{
+  if (currentState != RUNNING)
+  {
+    return 0;
+  }
+  if (now - started > timeout)
+  {
+    currentState = FAILED;
+    return 0;
+  }
+
+  if (input > peakHigh)
+  {
+    peakHigh = input;
+  }
+  if (input < peakLow)
+  {
+    peakLow = input;
+  }
+
+  if (relayOn && input > setPoint + hysteresis)
+  {
+    relayOn = false;
+  }
+  else if (!relayOn && input < setPoint - hysteresis)
+  {
+    relayOn = true;
+    if (switches > 0)
+    {
+      amplitudeSum += (peakHigh - peakLow) / 2;
+      periodSum += (now - lastOn) / 1000.0f;
+      measured++;
+    }
+    switches++;
+    lastOn = now;
+    peakHigh = -INFINITY;
+    peakLow = INFINITY;
+    if (measured >= cycles)
+    {
+      finish();
+      return 0;
+    }
+  }
+  return relayOn ? outputHigh : 0;
+}
+
+void RelayAutotune::finish()
+{
+  float amplitude = amplitudeSum / measured;
+  pu = periodSum / measured;
+  if (amplitude <= 0 || pu <= 0)
+  {
+    currentState = FAILED;
+    return;
+  }
+  // first harmonic of a relay with amplitude d = outputHigh / 2
+  ku = 4 * (outputHigh / 2) / ((float)M_PI * amplitude);
+  currentState = DONE;
+}
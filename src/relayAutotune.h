@@ -0,0 +1,67 @@
+/********************************************************
+  RelayAutotune - relay feedback autotune (Astrom-Hagglund)
+  The heater is switched between 0 and a fixed output around
+  the setPoint with some hysteresis, which makes the boiler
+  oscillate at its critical period. From the temperature
+  amplitude and the period the ultimate gain Ku and period Pu
+  follow, the tunings are derived from them with the
+  Tyreus-Luyben rule (little overshoot, suits slow thermal
+  plants better than Ziegler-Nichols).
+******************************************************/
+
+#ifndef _relayAutotune_H
+#define _relayAutotune_H
+
+class RelayAutotune
+{
+public:
+  enum State
+  {
+    IDLE,
+    RUNNING,
+    DONE,
+    FAILED
+  };
+
+  // outputHigh: output while the relay is on, hysteresis in °C, cycles: measured periods
+  RelayAutotune(float outputHigh, float hysteresis, unsigned cycles, unsigned long timeoutMs);
+
+  void start(float setPoint, unsigned long now);
+  void stop(); // ends a running autotune, the result of a finished one stays available
+
+  // once per new temperature value, returns the output to apply
+  float update(float input, unsigned long now);
+
+  State state() const { return currentState; }
+  float ultimateGain() const { return ku; }
+  float ultimatePeriod() const { return pu; } // s
+
+  // tunings as AGGKP/AGGTN/AGGTV
+  float kp() const { return ku / 2.2f; }
+  float tn() const { return 2.2f * pu; }
+  float tv() const { return pu / 6.3f; }
+
+private:
+  void finish();
+
+  float outputHigh;
+  float hysteresis;
+  unsigned cycles;
+  unsigned long timeout;
+
+  State currentState = IDLE;
+  float setPoint = 0;
+  bool relayOn = false;
+  unsigned long started = 0;
+  unsigned long lastOn = 0;     // last switch on, start of a period
+  float peakHigh = 0;           // extremes of the running half periods
+  float peakLow = 0;
+  unsigned switches = 0;        // number of switch ons so far
+  float amplitudeSum = 0;
+  float periodSum = 0;
+  unsigned measured = 0;
+  float ku = 0;
+  float pu = 0;
+};
+
+#endif // _relayAutotune_H
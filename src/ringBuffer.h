@@ -0,0 +1,74 @@
+/********************************************************
+  RingBuffer - lock-free single producer ring
+  The producer (a task or an ISR) never waits: it overwrites
+  the oldest slot and publishes the new head. Readers copy a
+  slot and check afterwards that the producer has not lapped
+  it meanwhile, so they see consistent samples without a lock.
+  Size must be a power of two.
+******************************************************/
+
+#ifndef _ringBuffer_H
+#define _ringBuffer_H
+
+#include <atomic>
+#include <stdint.h>
+
+template <typename T, uint32_t Size>
+class RingBuffer
+{
+public:
+  static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "ring size must be a power of two");
+
+  // producer only
+  void push(const T &value)
+  {
+    uint32_t head = this->head.load(std::memory_order_relaxed);
+    slots[head & (Size - 1)] = value;
+    this->head.store(head + 1, std::memory_order_release);
+  }
+
+  // number of values pushed so far, wraps
+  uint32_t count() const { return head.load(std::memory_order_acquire); }
+
+  // age 0 is the newest value, false if there is none (yet) or it was overwritten
+  bool at(uint32_t age, T &value) const
+  {
+    for (;;)
+    {
+      uint32_t head = this->head.load(std::memory_order_acquire);
+      if (age >= head || age >= Size - 1)
+        return false;
+      value = slots[(head - 1 - age) & (Size - 1)];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint32_t now = this->head.load(std::memory_order_relaxed);
+      if (now - head < Size - 1 - age)
+        return true; // the slot was not reused while copying
+    }
+  }
+
+  // value number index (count() - 1 is the newest), false if not pushed yet or overwritten
+  bool read(uint32_t index, T &value) const
+  {
+    uint32_t head = this->head.load(std::memory_order_acquire);
+    if (head - index - 1 >= Size - 1)
+      return false;
+    value = slots[index & (Size - 1)];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t now = this->head.load(std::memory_order_relaxed);
+    return now - index < Size; // the slot was not reused while copying
+  }
+
+  // newest value, T() before the first push
+  T latest() const
+  {
+    T value = T();
+    at(0, value);
+    return value;
+  }
+
+private:
+  std::atomic<uint32_t> head{0};
+  T slots[Size];
+};
+
+#endif // _ringBuffer_H
@@ -0,0 +1,154 @@
+/********************************************************
+  ShotRecorder - record of a shot, delta encoded in flash
+******************************************************/
+
+#include <Arduino.h>
+#include "shotRecorder.h"
+
+namespace
+{
+  int16_t fixedPoint(float value, float scale)
+  {
+    float scaled = value * scale;
+    scaled = scaled > 32767 ? 32767 : scaled < -32768 ? -32768 : scaled;
+    return (int16_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+  }
+
+  void putLittleEndian(uint8_t *buffer, uint32_t value, uint8_t bytes)
+  {
+    for (uint8_t i = 0; i < bytes; i++)
+    {
+      buffer[i] = value >> (8 * i);
+    }
+  }
+}
+
+ShotRecorder::ShotRecorder(unsigned long interval)
+    : interval(interval)
+{
+}
+
+void ShotRecorder::start(float setPoint)
+{
+  this->setPoint = fixedPoint(setPoint, 100);
+  first = 0;
+  count = 0;
+  dropped = 0;
+  running = true;
+}
+
+void ShotRecorder::record(unsigned long now, unsigned long brewTime, float temperature, float output, float weight)
+{
+  if (!running || (count > 0 && now - lastRecord < interval))
+  {
+    return;
+  }
+  lastRecord = now;
+
+  uint16_t index = first + count;
+  if (count < maxPoints)
+  {
+    count++;
+  }
+  else
+  {
+    first = (first + 1) % maxPoints; // full, the oldest point goes
+    dropped++;
+  }
+  ShotPoint &point = points[index % maxPoints];
+  point.time = brewTime;
+  point.temperature = fixedPoint(temperature, 100);
+  point.output = fixedPoint(output, 1);
+  point.weight = fixedPoint(weight, 10);
+}
+
+void ShotRecorder::stop()
+{
+  running = false;
+}
+
+uint8_t ShotRecorder::putVarint(uint8_t *buffer, int32_t value)
+{
+  uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); // small magnitudes, either sign, in few bytes
+  uint8_t length = 0;
+  while (zigzag >= 0x80)
+  {
+    buffer[length++] = (zigzag & 0x7f) | 0x80;
+    zigzag >>= 7;
+  }
+  buffer[length++] = zigzag;
+  return length;
+}
+
+uint8_t ShotRecorder::encode(const ShotPoint &point, const ShotPoint &previous, uint8_t *buffer) const
+{
+  uint8_t length = putVarint(buffer, (int32_t)(point.time - previous.time));
+  length += putVarint(buffer + length, point.temperature - previous.temperature);
+  length += putVarint(buffer + length, point.output - previous.output);
+  length += putVarint(buffer + length, point.weight - previous.weight);
+  return length;
+}
+
+bool ShotRecorder::flush(fs::FS &fs, const char *path, const char *oldPath, size_t maxFileSize, float finalWeight)
+{
+  if (!pending())
+  {
+    return false;
+  }
+
+  // first pass for the payload size, so the header can go first and nothing is buffered
+  uint8_t buffer[64];
+  uint32_t payload = 0;
+  ShotPoint previous = {0, 0, 0, 0};
+  for (uint16_t i = 0; i < count; i++)
+  {
+    const ShotPoint &point = points[(first + i) % maxPoints];
+    payload += encode(point, previous, buffer);
+    previous = point;
+  }
+
+  File file = fs.open(path, FILE_APPEND);
+  if (file && file.size() + headerSize + payload > maxFileSize)
+  {
+    file.close();
+    fs.remove(oldPath);
+    fs.rename(path, oldPath);
+    file = fs.open(path, FILE_APPEND);
+  }
+  if (!file)
+  {
+    count = 0; // no file system, the shot is lost
+    return false;
+  }
+
+  uint8_t header[headerSize] = {'S', 'H', 'O', 'T', version};
+  putLittleEndian(header + 5, interval, 2);
+  putLittleEndian(header + 7, count, 2);
+  putLittleEndian(header + 9, dropped, 2);
+  putLittleEndian(header + 11, (uint16_t)setPoint, 2);
+  putLittleEndian(header + 13, (uint16_t)fixedPoint(finalWeight, 10), 2);
+  putLittleEndian(header + 15, payload, 4);
+  bool ok = file.write(header, headerSize) == headerSize;
+
+  // points in chunks, one write per buffer
+  uint8_t used = 0;
+  previous = {0, 0, 0, 0};
+  for (uint16_t i = 0; i < count && ok; i++)
+  {
+    const ShotPoint &point = points[(first + i) % maxPoints];
+    if (used > sizeof(buffer) - 20) // a point takes up to 5 + 3 * 3 bytes
+    {
+      ok = file.write(buffer, used) == used;
+      used = 0;
+    }
+    used += encode(point, previous, buffer + used);
+    previous = point;
+  }
+  if (ok && used > 0)
+  {
+    ok = file.write(buffer, used) == used;
+  }
+  file.close();
+  count = 0;
+  return ok;
+}
@@ -0,0 +1,71 @@
+/********************************************************
+  ShotRecorder - record of brew time, temperature, heater
+  output and weight during a shot
+  Points go into a preallocated ring at a fixed interval
+  while the pump runs (the newest maxPoints are kept); the
+  shot is written to flash only after it is over. Shots are
+  appended to one file, each one is:
+    'S' 'H' 'O' 'T'
+    uint8_t  version (1)
+    uint16_t interval in ms
+    uint16_t points
+    uint16_t dropped points (ring overrun at the start)
+    int16_t  setPoint in 1/100 °C
+    int16_t  final weight in 1/10 g
+    uint32_t payload bytes
+    payload: per point brew time in ms, temperature in
+             1/100 °C, heater output (0...1000) and weight in
+             1/10 g, each as zigzag LEB128 varint of the
+             difference to the previous point (to 0 for the
+             first one)
+  Header fields are little endian.
+******************************************************/
+
+#ifndef _shotRecorder_H
+#define _shotRecorder_H
+
+#include <stdint.h>
+#include <FS.h>
+
+struct ShotPoint
+{
+  uint32_t time;       // ms since brew start
+  int16_t temperature; // 1/100 °C
+  int16_t output;      // heater 0...1000
+  int16_t weight;      // 1/10 g
+};
+
+class ShotRecorder
+{
+public:
+  static const uint16_t maxPoints = 1200; // 60 s at 20 Hz
+  static const uint8_t version = 1;
+  static const uint8_t headerSize = 19;
+
+  explicit ShotRecorder(unsigned long interval); // ms between points
+
+  void start(float setPoint);
+  void record(unsigned long now, unsigned long brewTime, float temperature, float output, float weight);
+  void stop();
+
+  bool recording() const { return running; }
+  bool pending() const { return !running && count > 0; } // stopped, not written yet
+
+  // appends the stopped shot to file, moves a file above maxFileSize to oldPath first
+  bool flush(fs::FS &fs, const char *path, const char *oldPath, size_t maxFileSize, float finalWeight);
+
+private:
+  static uint8_t putVarint(uint8_t *buffer, int32_t value);
+  uint8_t encode(const ShotPoint &point, const ShotPoint &previous, uint8_t *buffer) const;
+
+  unsigned long interval;
+  unsigned long lastRecord = 0;
+  bool running = false;
+  int16_t setPoint = 0;
+  uint16_t first = 0; // oldest point in the ring
+  uint16_t count = 0;
+  uint16_t dropped = 0;
+  ShotPoint points[maxPoints];
+};
+
+#endif // _shotRecorder_H
@@ -0,0 +1,41 @@
+/********************************************************
+  SmithPredictor - dead time compensation for the boiler PID
+******************************************************/
+
+#include <math.h>
+#include "smithPredictor.h"
+
+SmithPredictor::SmithPredictor(float gain, float timeConstant, float deadTime, float sampleTime)
+    : gain(gain)
+{
+  alpha = timeConstant > 0 ? expf(-sampleTime / timeConstant) : 0;
+  float samples = sampleTime > 0 ? deadTime / sampleTime + 0.5f : 0;
+  delaySamples = samples < 0 ? 0 : samples > maxDelaySamples ? maxDelaySamples : (uint8_t)samples;
+  reset();
+}
+
+void SmithPredictor::reset()
+{
+  model = 0;
+  index = 0;
+  for (uint8_t i = 0; i < maxDelaySamples; i++)
+  {
+    history[i] = 0;
+  }
+}
+
+void SmithPredictor::update(float output)
+{
+  if (delaySamples > 0)
+  {
+    history[index] = model;
+    index = (index + 1) % delaySamples;
+  }
+  model = alpha * model + (1 - alpha) * gain * output;
+}
+
+float SmithPredictor::correction() const
+{
+  // history[index] is the oldest entry, delaySamples samples back
+  return delaySamples > 0 ? model - history[index] : 0;
+}
@@ -0,0 +1,40 @@
+/********************************************************
+  SmithPredictor - dead time compensation for the boiler PID
+  The TSIC sits outside on the boiler, heat from the element
+  reaches it only after a dead time, so the PID reacts late
+  and overshoots. A first order plus dead time model of the
+  boiler runs next to the real one; the PID gets the measured
+  temperature plus what the model expects to arrive within the
+  dead time from the output already applied:
+    input = measured + model(now) - model(now - dead time)
+  Runs in the control task once per PID sample, a handful of
+  float operations.
+******************************************************/
+
+#ifndef _smithPredictor_H
+#define _smithPredictor_H
+
+#include <stdint.h>
+
+class SmithPredictor
+{
+public:
+  static const uint8_t maxDelaySamples = 64;
+
+  // gain: °C per output unit, timeConstant, deadTime and sampleTime in s
+  SmithPredictor(float gain, float timeConstant, float deadTime, float sampleTime);
+
+  void reset();                 // model back to rest, e.g. when the PID starts again
+  void update(float output);    // once per sample with the output applied for the coming sample
+  float correction() const;     // add to the measured input
+
+private:
+  float gain;
+  float alpha;                  // exp(-sampleTime / timeConstant)
+  uint8_t delaySamples;
+  uint8_t index = 0;
+  float model = 0;              // undelayed model output
+  float history[maxDelaySamples]; // model output of the last delaySamples samples
+};
+
+#endif // _smithPredictor_H
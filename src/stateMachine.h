@@ -0,0 +1,145 @@
+/********************************************************
+  StateMachine - table driven state machine for brew and
+  backflush
+  Every state is one row of a constexpr table: an entry
+  action, a guard that leaves to next, and a timeout (ms in
+  the state) or deadline (ms since the machine left its idle
+  state, the first row) that leaves to timeoutNext. Times are
+  functions, so values changed in Blynk apply right away. An
+  abort guard of the machine moves every abortable state to
+  the abort state. step() makes at most one transition, like
+  the switch statements it replaces. validStates() checks a
+  table at compile time. nextDeadline() tells when the timed
+  transition of the state is due, so the caller can run step()
+  right then instead of one polling period later; guards are
+  inputs and still have to be polled.
+******************************************************/
+
+#ifndef _stateMachine_H
+#define _stateMachine_H
+
+#include <stdint.h>
+
+struct StateRow
+{
+  uint8_t state;               // brewcounter/backflushState value
+  void (*entry)();             // on entering, nullptr = none
+  bool (*guard)();             // leave to next when true, nullptr = never
+  uint8_t next;
+  unsigned long (*timeout)();  // ms in this state, nullptr = none
+  unsigned long (*deadline)(); // ms since the machine started, nullptr = none
+  uint8_t timeoutNext;         // after the timeout or deadline
+  bool abortable;
+};
+
+constexpr bool hasState(const StateRow *rows, uint8_t count, uint8_t state)
+{
+  return count > 0 && (rows->state == state || hasState(rows + 1, count - 1, state));
+}
+
+constexpr bool validRows(const StateRow *rows, uint8_t count, const StateRow *row, uint8_t left)
+{
+  return left == 0 ||
+         ((!row->guard || hasState(rows, count, row->next)) &&
+          ((!row->timeout && !row->deadline) || hasState(rows, count, row->timeoutNext)) &&
+          validRows(rows, count, row + 1, left - 1));
+}
+
+// every transition leads to a state of the table
+template <uint8_t count>
+constexpr bool validStates(const StateRow (&rows)[count])
+{
+  return count > 0 && validRows(rows, count, rows, count);
+}
+
+class StateMachine
+{
+public:
+  template <uint8_t count>
+  StateMachine(const StateRow (&rows)[count], bool (*abort)(), uint8_t abortState)
+      : rows(rows), count(count), abort(abort), abortState(abortState)
+  {
+  }
+
+  uint8_t state() const { return rows[index].state; }
+  bool idle() const { return index == 0; }
+  unsigned long elapsed(unsigned long now) const { return idle() ? 0 : now - started; }
+
+  static const unsigned long noDeadline = (unsigned long)-1;
+
+  // ms until step() takes the timeout or deadline of the state, 0 = due, noDeadline = guards only
+  unsigned long nextDeadline(unsigned long now) const
+  {
+    const StateRow &row = rows[index];
+    unsigned long next = noDeadline;
+    if (row.timeout)
+    {
+      next = remaining(entered, row.timeout(), now);
+    }
+    if (row.deadline)
+    {
+      unsigned long deadline = remaining(started, row.deadline(), now);
+      next = deadline < next ? deadline : next;
+    }
+    return next;
+  }
+
+  void step(unsigned long now)
+  {
+    const StateRow &row = rows[index];
+    if (row.abortable && abort && abort())
+    {
+      jump(abortState, now);
+    }
+    else if (row.guard && row.guard())
+    {
+      jump(row.next, now);
+    }
+    else if ((row.timeout && now - entered > row.timeout()) || (row.deadline && now - started > row.deadline()))
+    {
+      jump(row.timeoutNext, now);
+    }
+  }
+
+  // also for forced resets from outside, runs the entry action
+  void jump(uint8_t state, unsigned long now)
+  {
+    uint8_t next = 0;
+    while (next < count && rows[next].state != state)
+    {
+      next++;
+    }
+    if (next == count)
+    {
+      return; // validStates() rules this out for the table itself
+    }
+    if (index == 0 && next != 0)
+    {
+      started = now;
+    }
+    index = next;
+    entered = now;
+    if (rows[index].entry)
+    {
+      rows[index].entry();
+    }
+  }
+
+private:
+  // step() compares with >, the transition is one ms after the limit
+  static unsigned long remaining(unsigned long since, unsigned long limit, unsigned long now)
+  {
+    unsigned long passed = now - since;
+    return passed > limit ? 0 : limit - passed + 1;
+  }
+
+  const StateRow *rows;
+  uint8_t count;
+  bool (*abort)();
+  uint8_t abortState;
+  uint8_t index = 0;
+  unsigned long entered = 0;
+  unsigned long started = 0;
+};
+
+#endif // _stateMachine_H
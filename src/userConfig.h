@@ -60,21 +60,61 @@
 #define STARTKP 50   // Start Kp during coldstart
 #define STARTTN 150  // Start Tn during cold start
 
+//Heater output (time proportioning)
+#define HEATERWINDOW 1000   // length of one heater window in ms, the PID calculates once per window
+#define HEATERSLOTS 100     // slots per window = resolution of the heater output (100 -> 10 ms steps)
+#define HEATERMODE 0        // 0 = one on-block per window, 1 = burst fire of whole mains half-waves (zero-cross detector on pinZeroCross needed)
+
+//Controller, the model is identified with the simulator (tools/sim, --identify) or a step test on the machine
+#define CONTROLLER 0              // 0 = PID, 1 = PID with Smith predictor (compensates the sensor dead time)
+#define MODELGAIN 1.11            // boiler model: °C per heater output unit (0...1000) in steady state
+#define MODELTIMECONSTANT 1940    // boiler model: time constant in s
+#define MODELDEADTIME 3.5         // boiler model: dead time in s until the sensor sees the heater
+
+//Feed-forward heater boost during brew, starts with the pump (brew states 20 and 40) or the hardware brew switch
+#define BREWBOOST 0  // 0 = off, 1 = on (Blynk V42)
+#define BREWBOOSTPROFILE {0, 500}, {25000, 500}, {35000, 0}  // {ms since start, heater output 0...1000 added}, linear in between
+
+//Relay autotune, started with Blynk V41 = 1, the result replaces AGGKP/AGGTN/AGGTV and is stored in the eeprom
+#define AUTOTUNEOUTPUT 500      // heater output while the relay is on (0...1000)
+#define AUTOTUNEHYSTERESIS 0.3  // relay switches at setPoint +- hysteresis, keep it above the sensor noise
+#define AUTOTUNECYCLES 3        // oscillation periods that are measured
+#define AUTOTUNETIMEOUT 60      // minutes, the autotune is given up after this
+#define AUTOTUNECEILING 5       // autotune is aborted above setPoint + ceiling
+
+//Scale filter, per weight cell: outlier rejection, median of 3, Kalman filter for weight and flow
+#define WEIGHTPROCESSNOISE 2.0      // g^2/s^3, higher follows flow changes faster, lower is smoother
+#define WEIGHTMEASUREMENTNOISE 0.25 // g^2, variance of a reading while the pump runs
+#define WEIGHTOUTLIERGATE 5         // readings further off than this many standard deviations are dropped
+
+//Pump profile, needs a solid state relay for the pump and the zero-cross detector on pinZeroCross
+#define PUMPMODE 0              // 0 = relay, preinfusion/pause/brew times; 1 = pump power switched per mains period, BREWPROFILE
+#define BREWPROFILE /* {PumpProfile::POWER in % or ::FLOW in g/s, start, end, duration in ms, until weight in g or 0}, up to 16 */ \
+  {PumpProfile::POWER, 100, 100, 2000, 0},  /* preinfusion */ \
+  {PumpProfile::POWER, 0, 0, 5000, 0},      /* pause */ \
+  {PumpProfile::POWER, 60, 100, 4000, 0},   /* ramp up */ \
+  {PumpProfile::FLOW, 2.0, 2.0, 40000, 0}   /* brew at 2 g/s, until the time above or the target weight */
+#define PROFILEFLOWGAIN 100     // flow segments: pump power (0...1000) per g/s of flow error per second
+
+//Shot recorder, brew time, temperature, heater output and weight of every shot are appended to /shots.bin on SPIFFS
+#define SHOTRECORDER 1          // 0 = off, 1 = on
+#define SHOTRECORDINTERVAL 50   // ms between two points, 20...100 (50 = 20 Hz)
+
 //backflush values
 #define FILLTIME 3000       // time in ms the pump is running
 #define FLUSHTIME 6000      // time in ms the 3-way valve is open -> backflush
 #define MAXFLUSHCYCLES 5      // number of cycles the backflush should run; 0 = disabled
 
 //PIN BELEGUNG
-#define ONE_WIRE_BUS 2  // TEMP SENSOR PIN
+#define ONE_WIRE_BUS 13 // TEMP SENSOR PIN
 
-#define pinRelayVentil    12    //Output pin for 3-way-valve
-#define pinRelayPumpe     13    //Output pin for pump
-#define pinRelayHeater    14    //Output pin for heater
+#define pinRelayVentil    33    //Output pin for 3-way-valve
+#define pinRelayPumpe     32    //Output pin for pump
+#define pinRelayHeater    15    //Output pin for heater
 
-#define OLED_RESET 16     //Output pin for dispaly reset pin
-#define OLED_SCL 5        //Output pin for dispaly clock pin
-#define OLED_SDA 4        //Output pin for dispaly data pin
+#define OLED_RESET -1     //Output pin for dispaly reset pin
+#define OLED_SCL 22       //Output pin for dispaly clock pin
+#define OLED_SDA 21       //Output pin for dispaly data pin
 #define SCREEN_WIDTH 128 // OLED display width, in pixels
 #define SCREEN_HEIGHT 64 // OLED display height, in pixels  
 
@@ -0,0 +1,90 @@
+/********************************************************
+  WeightFilter - filtering of one weight cell
+******************************************************/
+
+#include "weightFilter.h"
+
+WeightFilter::WeightFilter(float processNoise, float measurementNoise, float outlierGate)
+    : q(processNoise), r(measurementNoise), gate(outlierGate)
+{
+  reset();
+}
+
+void WeightFilter::reset()
+{
+  started = false;
+  windowIndex = 0;
+  windowCount = 0;
+  rejected = 0;
+  x = 0;
+  v = 0;
+}
+
+void WeightFilter::restart(float reading)
+{
+  started = true;
+  windowIndex = 0;
+  windowCount = 0;
+  rejected = 0;
+  x = reading;
+  v = 0;
+  p00 = r;
+  p01 = 0;
+  p11 = 1; // (g/s)^2, the flow is not known yet
+}
+
+float WeightFilter::median() const
+{
+  float sorted[medianSize];
+  for (uint8_t i = 0; i < windowCount; i++)
+  {
+    uint8_t j = i;
+    for (; j > 0 && sorted[j - 1] > window[i]; j--)
+      sorted[j] = sorted[j - 1];
+    sorted[j] = window[i];
+  }
+  return windowCount & 1 ? sorted[windowCount / 2] : (sorted[windowCount / 2 - 1] + sorted[windowCount / 2]) / 2;
+}
+
+void WeightFilter::update(float reading, float dt)
+{
+  if (!started)
+  {
+    restart(reading);
+  }
+
+  // predict
+  x += v * dt;
+  float dt2 = dt * dt;
+  p00 += dt * (2 * p01 + dt * p11) + q * dt2 * dt / 3;
+  p01 += dt * p11 + q * dt2 / 2;
+  p11 += q * dt;
+
+  // outlier rejection on the raw reading
+  float s = p00 + r;
+  float innovation = reading - x;
+  if (innovation * innovation > gate * gate * s)
+  {
+    if (++rejected >= maxRejected)
+    {
+      restart(reading); // it stays there, so it is a step and no spike
+    }
+    return;
+  }
+  rejected = 0;
+
+  window[windowIndex] = reading;
+  windowIndex = (windowIndex + 1) % medianSize;
+  if (windowCount < medianSize)
+    windowCount++;
+
+  // correct with the median
+  innovation = median() - x;
+  float k0 = p00 / s;
+  float k1 = p01 / s;
+  x += k0 * innovation;
+  v += k1 * innovation;
+  p11 -= k1 * p01;
+  p01 -= k0 * p01;
+  p00 -= k0 * p00;
+}
@@ -0,0 +1,55 @@
+/********************************************************
+  WeightFilter - filtering of one weight cell
+  Pump vibration shakes the scale, single readings can be off
+  by tens of grams. Every reading passes three stages:
+  - outlier rejection: a reading further than outlierGate
+    standard deviations from the prediction is dropped, after
+    maxRejected drops in a row it is a real step (cup put on)
+    and the filter starts over there
+  - median of the last medianSize accepted readings
+  - Kalman filter with weight and weight rate as state and a
+    constant rate model, processNoise sets how fast the rate
+    may change (g^2/s^3), measurementNoise the variance of the
+    median (g^2)
+  Runs in the weight task, a few dozen float operations.
+******************************************************/
+
+#ifndef _weightFilter_H
+#define _weightFilter_H
+
+#include <stdint.h>
+
+class WeightFilter
+{
+public:
+  static const uint8_t medianSize = 3;
+  static const uint8_t maxRejected = 3;
+
+  WeightFilter(float processNoise, float measurementNoise, float outlierGate);
+
+  void reset();                 // e.g. after a tare, the next reading starts the filter
+  void update(float reading, float dt); // dt in s since the last reading of this cell
+
+  float weight() const { return x; }  // g
+  float rate() const { return v; }    // g/s
+
+private:
+  float median() const;
+  void restart(float reading);
+
+  float q;
+  float r;
+  float gate;
+
+  bool started = false;
+  float window[medianSize];
+  uint8_t windowIndex = 0;
+  uint8_t windowCount = 0;
+  uint8_t rejected = 0;
+
+  float x = 0;                  // weight
+  float v = 0;                  // rate
+  float p00 = 0, p01 = 0, p11 = 0; // covariance
+};
+
+#endif // _weightFilter_H
@@ -0,0 +1,110 @@
+/********************************************************
+  WeightSampler - background sampling of both weight cells
+******************************************************/
+
+#include <Arduino.h>
+#include "weightSampler.h"
+
+WeightSampler::WeightSampler(HX711 &left, HX711 &right, float processNoise, float measurementNoise, float outlierGate)
+    : filters{WeightFilter(processNoise, measurementNoise, outlierGate), WeightFilter(processNoise, measurementNoise, outlierGate)}
+{
+  cells[0] = &left;
+  cells[1] = &right;
+}
+
+void WeightSampler::tare()
+{
+  tarePending.fetch_or(3, std::memory_order_acq_rel);
+}
+
+bool WeightSampler::tareDone() const
+{
+  return tarePending.load(std::memory_order_acquire) == 0;
+}
+
+void WeightSampler::startSession()
+{
+  tare();
+  state.store(TARING, std::memory_order_release);
+}
+
+void WeightSampler::stopSession(unsigned long settleTime)
+{
+  settleEnd.store(millis() + settleTime, std::memory_order_relaxed);
+  uint8_t running = RUNNING;
+  if (!state.compare_exchange_strong(running, SETTLING, std::memory_order_acq_rel))
+  {
+    uint8_t taring = TARING; // stopped before the tare was through, nothing in the cup
+    state.compare_exchange_strong(taring, DONE, std::memory_order_acq_rel);
+  }
+}
+
+float WeightSampler::weight() const
+{
+  switch (session())
+  {
+  case RUNNING:
+  case SETTLING:
+    return latest().filtered;
+  case DONE:
+    return finalWeight.load(std::memory_order_relaxed);
+  default:
+    return 0;
+  }
+}
+
+bool WeightSampler::readCell(uint8_t cell)
+{
+  HX711 &hx711 = *cells[cell];
+  if (!hx711.is_ready())
+    return false;
+
+  long raw = hx711.read(); // ~50 us of clocking, the conversion is already done
+  unsigned long now = micros();
+  uint8_t bit = 1 << cell;
+  if (tarePending.load(std::memory_order_acquire) & bit)
+  {
+    // one noisy conversion would bias the whole shot, average like HX711::tare()
+    tareSum[cell] += raw;
+    readTime[cell] = now;
+    if (++tareCount[cell] < tareReadings)
+      return false;
+    hx711.set_offset(tareSum[cell] / tareReadings);
+    tareSum[cell] = 0;
+    tareCount[cell] = 0;
+    tarePending.fetch_and(~bit, std::memory_order_acq_rel);
+    filters[cell].reset(); // do not filter across the tare
+  }
+  units[cell] = (raw - hx711.get_offset()) / hx711.get_scale();
+  filters[cell].update(units[cell], (now - readTime[cell]) / 1000000.0f);
+  readTime[cell] = now;
+  return true;
+}
+
+void WeightSampler::poll()
+{
+  bool changed = readCell(0);
+  changed |= readCell(1);
+  if (!changed)
+    return;
+
+  WeightSample sample;
+  sample.time = millis();
+  sample.weight = units[0] + units[1];
+  sample.filtered = filters[0].weight() + filters[1].weight();
+  sample.flow = filters[0].rate() + filters[1].rate();
+
+  samples.push(sample);
+
+  // session transitions of the sampler side, loop() may move on at the same time
+  uint8_t current = state.load(std::memory_order_acquire);
+  if (current == TARING && tareDone())
+  {
+    state.compare_exchange_strong(current, RUNNING, std::memory_order_acq_rel);
+  }
+  else if (current == SETTLING && (long)(sample.time - settleEnd.load(std::memory_order_relaxed)) >= 0)
+  {
+    finalWeight.store(sample.filtered, std::memory_order_relaxed);
+    state.compare_exchange_strong(current, DONE, std::memory_order_acq_rel);
+  }
+}
@@ -0,0 +1,75 @@
+/********************************************************
+  WeightSampler - background sampling of both weight cells
+  Runs in its own task, woken by the data ready interrupts
+  of the HX711s (DOUT goes LOW when a conversion is done), so
+  a reading never waits for a conversion. Every reading of a
+  cell goes through its WeightFilter and updates the sum of
+  both cells, which is pushed into a lock-free ring; brew()
+  only looks at the newest sample.
+  A shot is a session: tare once at the start, stream while
+  the pump runs, freeze the weight once the drips have
+  settled after the stop.
+******************************************************/
+
+#ifndef _weightSampler_H
+#define _weightSampler_H
+
+#include <atomic>
+#include <HX711.h>
+#include "ringBuffer.h"
+#include "weightFilter.h"
+
+struct WeightSample
+{
+  unsigned long time; // ms, millis() of the reading
+  float weight;       // g, both cells, unfiltered
+  float filtered;     // g, both cells filtered
+  float flow;         // g/s, weight rate of both cells
+};
+
+class WeightSampler
+{
+public:
+  enum Session
+  {
+    IDLE,     // no shot yet
+    TARING,   // waiting for the tare readings of both cells
+    RUNNING,  // shot weight streams
+    SETTLING, // pump stopped, drips still come
+    DONE      // final weight frozen
+  };
+
+  static const uint32_t ringSize = 128; // 1.6 s at 80 SPS
+  static const uint8_t tareReadings = 10; // averaged per cell, as HX711::tare()
+
+  // noise and gate as in WeightFilter, the same for both cells
+  WeightSampler(HX711 &left, HX711 &right, float processNoise, float measurementNoise, float outlierGate);
+
+  void poll();                          // sampler task only: reads the cells that are ready
+  void tare();                          // any task: zero both cells with the mean of their next readings
+  bool tareDone() const;                // any task: the last tare() has been applied
+
+  void startSession();                  // loop(): tare and stream a new shot
+  void stopSession(unsigned long settleTime); // loop(): freeze the weight settleTime ms from now
+  Session session() const { return (Session)state.load(std::memory_order_acquire); }
+  float weight() const;                 // g in the shot, 0 while taring, frozen when done
+  WeightSample latest() const { return samples.latest(); }
+  const RingBuffer<WeightSample, ringSize> &history() const { return samples; }
+
+private:
+  bool readCell(uint8_t cell);
+
+  HX711 *cells[2];
+  WeightFilter filters[2];
+  float units[2] = {0, 0};              // latest unfiltered reading per cell
+  unsigned long readTime[2] = {0, 0};   // us, micros() of the latest reading per cell
+  std::atomic<uint8_t> tarePending{0};  // bit per cell
+  long tareSum[2] = {0, 0};             // sampler task only
+  uint8_t tareCount[2] = {0, 0};
+  RingBuffer<WeightSample, ringSize> samples;
+  std::atomic<uint8_t> state{IDLE};
+  std::atomic<unsigned long> settleEnd{0};
+  std::atomic<float> finalWeight{0};
+};
+
+#endif // _weightSampler_H
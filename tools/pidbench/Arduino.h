@@ -0,0 +1,13 @@
+/********************************************************
+  Minimal Arduino core for the host PID benchmark,
+  the clock is driven by the benchmark itself
+******************************************************/
+
+#ifndef _Arduino_H
+#define _Arduino_H
+
+#include <math.h>
+
+unsigned long millis();
+
+#endif // _Arduino_H
@@ -0,0 +1,163 @@
+/********************************************************
+  Host benchmark: BoilerPID (float) against br3ttb PID_v1 (double)
+  Both controllers close the loop around the same simple
+  boiler model with the offline tunings from userConfig.h.
+  The clock jumps one sample time per call, so every call
+  really computes. Prints cycles per Compute() and the
+  largest output difference between the two engines, and
+  the cost of one control step with the Smith predictor.
+  Note: the host has a double FPU, on the ESP32 double is
+  emulated in software and the gap is much larger.
+******************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "Arduino.h"
+#include "PID_v1.h"
+#include "boilerPID.h"
+#include "smithPredictor.h"
+#include "userConfig.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES "cycles"
+static uint64_t cycleCount()
+{
+  return __rdtsc();
+}
+#else
+#define CYCLES "ns"
+static uint64_t cycleCount()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+const unsigned long sampleTime = 1000; // ms, as in setup()
+const unsigned int windowSize = 1000;
+const long iterations = 2000000;
+
+unsigned long benchMillis = 0;
+
+unsigned long millis()
+{
+  return benchMillis;
+}
+
+// one second of a crude boiler: full heater power gives ~1.5 °C/s, losses towards 20 °C
+template <typename T>
+static T boiler(T temperature, T output)
+{
+  return temperature + output / windowSize * (T)1.5 - (temperature - 20) * (T)0.004;
+}
+
+struct Result
+{
+  double perCompute;
+  double lastOutput;
+};
+
+static uint64_t overhead()
+{
+  volatile double temperature = 20;
+  benchMillis = 0;
+  uint64_t start = cycleCount();
+  for (long i = 0; i < iterations; i++)
+  {
+    benchMillis += sampleTime;
+    temperature = boiler<double>(temperature, 500);
+  }
+  return cycleCount() - start;
+}
+
+template <typename T, typename Engine>
+static Result run(T *input, T *output, T *setPoint, Engine &pid, uint64_t loopOverhead, double *trace)
+{
+  pid.SetSampleTime(sampleTime);
+  pid.SetOutputLimits(0, windowSize);
+  pid.SetMode(AUTOMATIC);
+
+  uint64_t start = cycleCount();
+  for (long i = 0; i < iterations; i++)
+  {
+    benchMillis += sampleTime;
+    *input = boiler<T>(*input, *output);
+    pid.Compute();
+    if (trace && i < 3600)
+    {
+      trace[i] = *output;
+    }
+  }
+  uint64_t elapsed = cycleCount() - start;
+  Result result = {(double)(elapsed > loopOverhead ? elapsed - loopOverhead : 0) / iterations, (double)*output};
+  return result;
+}
+
+// one control task step with CONTROLLER 1: correction, Compute(), model update
+static Result runPredicted(float *input, float *output, float *setPoint, BoilerPID &pid, SmithPredictor &predictor,
+                           uint64_t loopOverhead)
+{
+  pid.SetSampleTime(sampleTime);
+  pid.SetOutputLimits(0, windowSize);
+  pid.SetMode(AUTOMATIC);
+
+  float measured = *input;
+  uint64_t start = cycleCount();
+  for (long i = 0; i < iterations; i++)
+  {
+    benchMillis += sampleTime;
+    measured = boiler<float>(measured, *output);
+    *input = measured + predictor.correction();
+    if (pid.Compute())
+    {
+      predictor.update(*output);
+    }
+  }
+  uint64_t elapsed = cycleCount() - start;
+  Result result = {(double)(elapsed > loopOverhead ? elapsed - loopOverhead : 0) / iterations, (double)*output};
+  return result;
+}
+
+int main()
+{
+  const double kp = AGGKP, ki = AGGTN == 0 ? 0 : (double)AGGKP / AGGTN, kd = (double)AGGTV * AGGKP;
+  static double traceDouble[3600], traceFloat[3600];
+
+  uint64_t loopOverhead = overhead();
+
+  benchMillis = 0;
+  double dInput = 20, dOutput = 0, dSetPoint = SETPOINT;
+  PID reference(&dInput, &dOutput, &dSetPoint, kp, ki, kd, P_ON_E, DIRECT);
+  Result old = run(&dInput, &dOutput, &dSetPoint, reference, loopOverhead, traceDouble);
+
+  benchMillis = 0;
+  float fInput = 20, fOutput = 0, fSetPoint = SETPOINT;
+  BoilerPID boilerPID(&fInput, &fOutput, &fSetPoint, kp, ki, kd, P_ON_E, DIRECT);
+  Result now = run(&fInput, &fOutput, &fSetPoint, boilerPID, loopOverhead, traceFloat);
+
+  benchMillis = 0;
+  float pInput = 20, pOutput = 0, pSetPoint = SETPOINT;
+  BoilerPID predictedPID(&pInput, &pOutput, &pSetPoint, kp, ki, kd, P_ON_E, DIRECT);
+  SmithPredictor predictor(MODELGAIN, MODELTIMECONSTANT, MODELDEADTIME, sampleTime / 1000.0f);
+  Result predicted = runPredicted(&pInput, &pOutput, &pSetPoint, predictedPID, predictor, loopOverhead);
+
+  double maxDifference = 0;
+  for (int i = 0; i < 3600; i++)
+  {
+    double difference = fabs(traceDouble[i] - traceFloat[i]);
+    if (difference > maxDifference)
+    {
+      maxDifference = difference;
+    }
+  }
+
+  printf("Compute() cost over %ld calls, Kp %.1f Ki %.4f Kd %.1f\n", iterations, kp, ki, kd);
+  printf("  PID_v1 (double)    %8.1f %s\n", old.perCompute, CYCLES);
+  printf("  BoilerPID (float)  %8.1f %s\n", now.perCompute, CYCLES);
+  printf("  + Smith predictor  %8.1f %s per control step\n", predicted.perCompute, CYCLES);
+  printf("max output difference over the first hour: %.4f (of %u)\n", maxDifference, windowSize);
+  return 0;
+}
@@ -0,0 +1,410 @@
+/********************************************************
+  Shot analytics - metrics of the shots recorded on the machine
+  Reads the shot files of the recorder (shots.bin/shots.old
+  from SPIFFS, format in src/shotRecorder.h), any number of
+  files or directories of them. Every file is memory mapped
+  and parsed by its own job on a work stealing pool, the
+  output keeps the order of the arguments.
+  "pio run -e shots" and call .pio/build/shots/program:
+    FILE|DIR ...                shot files, directories are read flat
+    --csv FILE                  one row per shot, default stdout
+    --columns DIR               one column per file (little endian
+                                float/uint32) plus DIR/schema.csv
+    --first-drop G              weight of the first drop, default 1 g
+    --jobs N                    parallel files, default one per core
+  Per shot: yield, time to the first drop, temperature drop
+  and the time to recover from it, mean flow after the first
+  drop, mean heater output.
+******************************************************/
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "threadPool.h"
+
+namespace
+{
+  const uint8_t headerSize = 19;
+  const uint8_t version = 1;
+
+  struct Point
+  {
+    uint32_t time;       // ms
+    int32_t temperature; // 1/100 °C
+    int32_t output;
+    int32_t weight;      // 1/10 g
+  };
+
+  struct Shot
+  {
+    uint32_t file;       // index into the file list
+    uint32_t index;      // shot in the file
+    uint32_t points;
+    uint32_t dropped;
+    float setPoint;      // °C
+    float yield;         // g, final weight
+    float brewTime;      // s, last point
+    float firstDrop;     // s, -1 = no drop
+    float startTemperature;
+    float temperatureDrop; // °C, start to minimum
+    float recovery;      // s from the minimum back to start - 0.5 °C, -1 = not within the shot
+    float meanFlow;      // g/s from the first drop to the end
+    float meanOutput;    // heater 0...1000
+  };
+
+  struct FileResult
+  {
+    std::vector<Shot> shots;
+    std::string error;
+  };
+
+  float firstDropWeight = 1.0f;
+
+  uint32_t littleEndian(const uint8_t *data, uint8_t bytes)
+  {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < bytes; i++)
+      value |= (uint32_t)data[i] << (8 * i);
+    return value;
+  }
+
+  // false on a varint running over the end
+  bool getVarint(const uint8_t *&data, const uint8_t *end, int32_t &value)
+  {
+    uint32_t zigzag = 0;
+    for (uint8_t shift = 0; data < end && shift < 35; shift += 7)
+    {
+      uint8_t byte = *data++;
+      zigzag |= (uint32_t)(byte & 0x7f) << shift;
+      if (byte < 0x80)
+      {
+        value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void analyse(const std::vector<Point> &points, Shot &shot)
+  {
+    shot.firstDrop = -1;
+    shot.recovery = -1;
+    shot.meanFlow = 0;
+    shot.meanOutput = 0;
+    shot.brewTime = shot.startTemperature = shot.temperatureDrop = 0;
+    if (points.empty())
+      return;
+
+    const Point &last = points.back();
+    shot.brewTime = last.time / 1000.0f;
+    shot.startTemperature = points[0].temperature / 100.0f;
+    if (shot.yield <= 0)
+      shot.yield = last.weight / 10.0f; // no final weight, e.g. the scale stopped delivering
+
+    size_t drop = points.size(), minimum = 0;
+    double output = 0;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+      if (drop == points.size() && points[i].weight >= firstDropWeight * 10)
+        drop = i;
+      if (points[i].temperature < points[minimum].temperature)
+        minimum = i;
+      output += points[i].output;
+    }
+    shot.meanOutput = output / points.size();
+    shot.temperatureDrop = (points[0].temperature - points[minimum].temperature) / 100.0f;
+
+    for (size_t i = minimum; i < points.size(); i++)
+    {
+      if (points[i].temperature >= points[0].temperature - 50) // 0.5 °C
+      {
+        shot.recovery = (points[i].time - points[minimum].time) / 1000.0f;
+        break;
+      }
+    }
+    if (drop < points.size())
+    {
+      const Point &first = points[drop];
+      shot.firstDrop = first.time / 1000.0f;
+      if (last.time > first.time)
+        shot.meanFlow = (last.weight - first.weight) / 10.0f / ((last.time - first.time) / 1000.0f);
+    }
+  }
+
+  // every shot of one mapped file, stops at the first damaged one
+  void parse(const uint8_t *data, size_t size, uint32_t file, FileResult &result)
+  {
+    std::vector<Point> points;
+    const uint8_t *end = data + size;
+    for (uint32_t index = 0; data < end; index++)
+    {
+      if ((size_t)(end - data) < headerSize || memcmp(data, "SHOT", 4) != 0 || data[4] != version)
+      {
+        result.error = "no shot header at offset " + std::to_string(size - (end - data));
+        return;
+      }
+      Shot shot = Shot();
+      shot.file = file;
+      shot.index = index;
+      shot.points = littleEndian(data + 7, 2);
+      shot.dropped = littleEndian(data + 9, 2);
+      shot.setPoint = (int16_t)littleEndian(data + 11, 2) / 100.0f;
+      shot.yield = (int16_t)littleEndian(data + 13, 2) / 10.0f;
+      uint32_t payload = littleEndian(data + 15, 4);
+      data += headerSize;
+      if ((size_t)(end - data) < payload)
+      {
+        result.error = "shot " + std::to_string(index) + " truncated";
+        return;
+      }
+
+      const uint8_t *next = data + payload;
+      Point point = Point();
+      points.clear();
+      for (uint32_t i = 0; i < shot.points; i++)
+      {
+        int32_t time, temperature, output, weight;
+        if (!getVarint(data, next, time) || !getVarint(data, next, temperature) || !getVarint(data, next, output) ||
+            !getVarint(data, next, weight))
+        {
+          result.error = "shot " + std::to_string(index) + " damaged";
+          return;
+        }
+        point.time += time;
+        point.temperature += temperature;
+        point.output += output;
+        point.weight += weight;
+        points.push_back(point);
+      }
+      data = next;
+      analyse(points, shot);
+      result.shots.push_back(shot);
+    }
+  }
+
+  void parseFile(const std::string &path, uint32_t file, FileResult &result)
+  {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0)
+    {
+      result.error = strerror(errno);
+      if (fd >= 0)
+        close(fd);
+      return;
+    }
+    if (status.st_size > 0)
+    {
+      void *data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+      {
+        result.error = strerror(errno);
+      }
+      else
+      {
+        madvise(data, status.st_size, MADV_SEQUENTIAL);
+        parse((const uint8_t *)data, status.st_size, file, result);
+        munmap(data, status.st_size);
+      }
+    }
+    close(fd);
+  }
+
+  // files as given, directories flat in name order
+  void collect(const char *path, std::vector<std::string> &files)
+  {
+    struct stat status;
+    if (stat(path, &status) != 0 || !S_ISDIR(status.st_mode))
+    {
+      files.push_back(path);
+      return;
+    }
+    struct dirent **entries;
+    int count = scandir(path, &entries, nullptr, alphasort);
+    for (int i = 0; i < count; i++)
+    {
+      std::string file = std::string(path) + "/" + entries[i]->d_name;
+      if (entries[i]->d_name[0] != '.' && stat(file.c_str(), &status) == 0 && S_ISREG(status.st_mode))
+        files.push_back(file);
+      free(entries[i]);
+    }
+    free(entries);
+  }
+
+  struct Column
+  {
+    const char *name;
+    const char *type; // float32 or uint32
+    size_t offset;
+  };
+
+  const Column columns[] = {
+      {"file", "uint32", offsetof(Shot, file)},
+      {"shot", "uint32", offsetof(Shot, index)},
+      {"points", "uint32", offsetof(Shot, points)},
+      {"dropped", "uint32", offsetof(Shot, dropped)},
+      {"setpoint_c", "float32", offsetof(Shot, setPoint)},
+      {"yield_g", "float32", offsetof(Shot, yield)},
+      {"brew_time_s", "float32", offsetof(Shot, brewTime)},
+      {"first_drop_s", "float32", offsetof(Shot, firstDrop)},
+      {"start_temp_c", "float32", offsetof(Shot, startTemperature)},
+      {"temp_drop_c", "float32", offsetof(Shot, temperatureDrop)},
+      {"recovery_s", "float32", offsetof(Shot, recovery)},
+      {"mean_flow_gps", "float32", offsetof(Shot, meanFlow)},
+      {"mean_output", "float32", offsetof(Shot, meanOutput)},
+  };
+
+  void writeCsv(FILE *out, const std::vector<std::string> &files, const std::vector<FileResult> &results)
+  {
+    fprintf(out, "path");
+    for (const Column &column : columns)
+      fprintf(out, ",%s", column.name);
+    fprintf(out, "\n");
+    for (const FileResult &result : results)
+    {
+      for (const Shot &shot : result.shots)
+      {
+        fprintf(out, "%s", files[shot.file].c_str());
+        for (const Column &column : columns)
+        {
+          const char *field = (const char *)&shot + column.offset;
+          if (column.type[0] == 'u')
+            fprintf(out, ",%u", *(const uint32_t *)field);
+          else
+            fprintf(out, ",%.2f", *(const float *)field);
+        }
+        fprintf(out, "\n");
+      }
+    }
+  }
+
+  // the host is little endian like the columns, so the values are written as they are
+  bool writeColumns(const std::string &directory, const std::vector<std::string> &files,
+                    const std::vector<FileResult> &results)
+  {
+    mkdir(directory.c_str(), 0755);
+    size_t rows = 0;
+    for (const FileResult &result : results)
+      rows += result.shots.size();
+
+    std::string schema = directory + "/schema.csv";
+    FILE *out = fopen(schema.c_str(), "w");
+    if (!out)
+      return false;
+    fprintf(out, "column,type,rows\n");
+    for (const Column &column : columns)
+      fprintf(out, "%s,%s,%zu\n", column.name, column.type, rows);
+    fprintf(out, "path,text,%zu\n", files.size()); // index of the file column
+    fclose(out);
+
+    for (const Column &column : columns)
+    {
+      std::string path = directory + "/" + column.name + (column.type[0] == 'u' ? ".u32" : ".f32");
+      out = fopen(path.c_str(), "wb");
+      if (!out)
+        return false;
+      for (const FileResult &result : results)
+        for (const Shot &shot : result.shots)
+          fwrite((const char *)&shot + column.offset, 4, 1, out);
+      fclose(out);
+    }
+
+    out = fopen((directory + "/path.txt").c_str(), "w");
+    if (!out)
+      return false;
+    for (const std::string &file : files)
+      fprintf(out, "%s\n", file.c_str());
+    fclose(out);
+    return true;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned jobs = std::thread::hardware_concurrency();
+  const char *csvPath = nullptr;
+  const char *columnsPath = nullptr;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *option = argv[i];
+    if (strncmp(option, "--", 2) != 0)
+    {
+      collect(option, files);
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      fprintf(stderr, "missing value for %s\n", option);
+      return 1;
+    }
+    const char *argument = argv[++i];
+    if (!strcmp(option, "--jobs"))
+      jobs = strtoul(argument, nullptr, 10);
+    else if (!strcmp(option, "--csv"))
+      csvPath = argument;
+    else if (!strcmp(option, "--columns"))
+      columnsPath = argument;
+    else if (!strcmp(option, "--first-drop"))
+      firstDropWeight = atof(argument);
+    else
+    {
+      fprintf(stderr, "bad option %s %s\n", option, argument);
+      return 1;
+    }
+  }
+  if (files.empty())
+  {
+    fprintf(stderr, "no shot files given\n");
+    return 1;
+  }
+
+  std::vector<FileResult> results(files.size());
+  {
+    ThreadPool pool(jobs);
+    for (size_t i = 0; i < files.size(); i++)
+    {
+      pool.submit([&, i] { parseFile(files[i], i, results[i]); });
+    }
+    pool.wait();
+  }
+
+  size_t shots = 0;
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    shots += results[i].shots.size();
+    if (!results[i].error.empty())
+      fprintf(stderr, "%s: %s\n", files[i].c_str(), results[i].error.c_str());
+  }
+  fprintf(stderr, "%zu shots in %zu files\n", shots, files.size());
+
+  if (columnsPath && !writeColumns(columnsPath, files, results))
+  {
+    fprintf(stderr, "%s: %s\n", columnsPath, strerror(errno));
+    return 1;
+  }
+  if (csvPath || !columnsPath)
+  {
+    FILE *out = csvPath ? fopen(csvPath, "w") : stdout;
+    if (!out)
+    {
+      fprintf(stderr, "%s: %s\n", csvPath, strerror(errno));
+      return 1;
+    }
+    writeCsv(out, files, results);
+    if (out != stdout)
+      fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,39 @@
+/********************************************************
+  BoilerModel - two node thermal model of a Silvia boiler
+******************************************************/
+
+#include "boilerModel.h"
+
+static const double waterHeatCapacity = 4.186; // J/(g K)
+
+BoilerModel::BoilerModel(const BoilerModelParameters &parameters, double stepSeconds)
+    : p(parameters), dt(stepSeconds), bodyTemperature(parameters.ambient), waterTemperature(parameters.ambient),
+      sensorTemperature(parameters.ambient), random(parameters.seed), noise(0, parameters.sensorNoise)
+{
+  size_t samples = (size_t)(p.sensorDeadTime / dt + 0.5);
+  deadTime.assign(samples > 0 ? samples : 1, p.ambient);
+}
+
+void BoilerModel::step(double heater, double flow)
+{
+  heater *= p.heaterPower;
+  double toWater = p.bodyToWater * (bodyTemperature - waterTemperature);
+  double toAmbient = p.ambientLoss * (bodyTemperature - p.ambient);
+  double brew = flow * waterHeatCapacity * (waterTemperature - p.inletTemperature);
+
+  bodyTemperature += (heater - toWater - toAmbient) * dt / p.bodyCapacity;
+  waterTemperature += (toWater - brew) * dt / p.waterCapacity;
+
+  // dead time, then first order sensor lag
+  double delayed = deadTime[deadTimeIndex];
+  deadTime[deadTimeIndex] = bodyTemperature;
+  deadTimeIndex = (deadTimeIndex + 1) % deadTime.size();
+  if (p.sensorTimeConstant > 0)
+  {
+    sensorTemperature += (delayed - sensorTemperature) * dt / p.sensorTimeConstant;
+  }
+  else
+  {
+    sensorTemperature = delayed;
+  }
+}
@@ -0,0 +1,57 @@
+/********************************************************
+  BoilerModel - two node thermal model of a Silvia boiler
+  Node 1 is the brass body with the heater element and the
+  temperature sensor, node 2 the water. The body loses heat
+  to ambient, brew flow replaces hot water with tank water.
+  The sensor sees the body through a dead time and a lag,
+  plus some noise.
+******************************************************/
+
+#ifndef _boilerModel_H
+#define _boilerModel_H
+
+#include <stddef.h>
+#include <random>
+#include <vector>
+
+struct BoilerModelParameters
+{
+  double heaterPower = 1000;      // W
+  double bodyCapacity = 500;      // J/K, brass boiler and element
+  double waterCapacity = 1250;    // J/K, about 300 ml
+  double bodyToWater = 150;       // W/K
+  double ambientLoss = 0.9;       // W/K, body to ambient
+  double ambient = 20;            // °C
+  double inletTemperature = 20;   // °C, water from the tank
+  double sensorDeadTime = 2;      // s
+  double sensorTimeConstant = 3;  // s
+  double sensorNoise = 0.05;      // °C, standard deviation
+  unsigned seed = 1;              // noise is repeatable per seed
+};
+
+class BoilerModel
+{
+public:
+  BoilerModel(const BoilerModelParameters &parameters, double stepSeconds);
+
+  // advance one step, heater: fraction of the step it was on, flow in g/s
+  void step(double heater, double flow);
+
+  double body() const { return bodyTemperature; }
+  double water() const { return waterTemperature; }
+  double sensor() { return sensorTemperature + noise(random); }
+  double stepSeconds() const { return dt; }
+
+private:
+  BoilerModelParameters p;
+  double dt;
+  double bodyTemperature;
+  double waterTemperature;
+  double sensorTemperature;
+  std::vector<double> deadTime; // ring buffer of body temperatures
+  size_t deadTimeIndex = 0;
+  std::mt19937 random;
+  std::normal_distribution<double> noise;
+};
+
+#endif // _boilerModel_H
@@ -0,0 +1,37 @@
+/********************************************************
+  Firmware globals of src/main.cpp used by the simulator
+  The parameters are preset before setup(), the way the
+  EEPROM fallback or Blynk would set them on the machine.
+******************************************************/
+
+#ifndef _firmware_H
+#define _firmware_H
+
+#include "relayAutotune.h"
+#include "smithPredictor.h"
+
+// pins as defined in src/userConfig.h and src/main.cpp
+#define simPinRelayHeater 15
+#define simPinRelayPumpe 32
+#define simPinZeroCross 34
+#define simAnalogPin 0
+
+extern double aggKp, aggTn, aggTv;
+extern double startKp, startTn;
+extern double aggbKp, aggbTn, aggbTv;
+extern double setPoint;
+extern double brewtimersoftware, brewboarder;
+extern double Input, Output;
+extern int Offlinemodus;
+extern int brewBoostON;
+extern int pidON, pidMode;
+extern int controller;
+extern SmithPredictor smithPredictor;
+extern RelayAutotune autotune;
+
+void setup();
+void loop();
+void startAutotune();
+void setManualOutput(double output);
+
+#endif // _firmware_H
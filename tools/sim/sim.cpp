@@ -0,0 +1,396 @@
+/********************************************************
+  Boiler simulator - the firmware against BoilerModel
+  Cold start from ambient, one shot, then recovery, all in
+  virtual time. Run with "pio run -e sim -t exec" or call
+  .pio/build/sim/program directly:
+    --kp X --tn X --tv X        AGGKP, AGGTN, AGGTV
+    --start-kp X --start-tn X   STARTKP, STARTTN
+    --brew-kp X --brew-tn X --brew-tv X   AGGBKP, AGGBTN, AGGBTV
+    --setpoint X                SETPOINT
+    --brew-at S                 start of the shot, default 900 s, 0 = no shot
+    --brew-time S               length of the shot, default 25 s
+    --flow X                    brew flow in g/s, default 2
+    --boost 0|1                 feed-forward heater boost during brew (BREWBOOST)
+    --controller 0|1            PID or PID with Smith predictor (CONTROLLER)
+    --model K:T:L               model of the Smith predictor (MODELGAIN, MODELTIMECONSTANT, MODELDEADTIME)
+    --seconds S                 length of the run, default 1200 s
+    --loop-us N                 time one loop() pass takes, default 1000 us
+    --heater-w X --dead-time S --sensor-lag S --noise X   plant parameters
+    --seed N                    seed of the sensor noise, default 1
+    --autotune S                start the relay autotune (pidMode 2) at S seconds, use with --brew-at 0
+    --sensor-error S            the sensor reads -127 (disconnected) from S seconds on, the
+                                heater must be off once the firmware has detected it
+    --identify X                open loop step to heater output X instead, fits the FOPDT model
+                                for the Smith predictor, needs --seconds long enough to settle
+    --trace FILE                water, body, Input and Output once per second as CSV
+    --verbose                   keep the Serial output of the firmware
+  Prints one line with the metrics, all taken on the water
+  temperature (what reaches the coffee), -1 = never reached:
+    rise_s       10 % -> 90 % of the step from ambient to setPoint
+    overshoot_c  highest water temperature above setPoint before the shot
+    settle_s     from then on within setPoint +- 0.5 until the shot
+    brew_drop_c  water temperature at the start of the shot minus the minimum during and after it
+    recovery_s   after the end of the shot back within setPoint +- 0.5 for good
+  and with --autotune a second line with Ku, Pu and the new tunings.
+  --sensor-error adds the heater on-time after the detection and
+  exits with 1 if the heater was on.
+  --identify prints the model (gain, time constant, dead time).
+******************************************************/
+
+#include <vector>
+#include "Arduino.h"
+#include "hal.h"
+#include "userConfig.h"
+#include "boilerModel.h"
+#include "firmware.h"
+
+namespace
+{
+  const uint64_t plantStepUs = 10000;
+  const uint64_t halfWaveUs = 10000; // 50 Hz mains
+  const double band = 0.5;           // °C
+
+  struct Scenario
+  {
+    double brewAt = 900;
+    double brewTime = 25;
+    double flow = 2;
+    double seconds = 1200;
+    double autotuneAt = 0;
+    double sensorErrorAt = 0;
+    double identify = 0; // heater output of the open loop step
+    unsigned long loopUs = 1000;
+  };
+
+  struct Metrics
+  {
+    double t10 = -1, t90 = -1;
+    double overshoot = 0;
+    double lastOutside = 0;
+    bool settled = false;
+    double brewStartTemperature = 0;
+    double brewMinimum = 1000;
+    double lastOutsideAfterBrew = 0;
+    bool recovered = false;
+  };
+
+  Scenario scenario;
+  Metrics metrics;
+  std::vector<double> stepResponse; // Input once per second from the step on, --identify
+  bool stepApplied = false;
+  BoilerModel *model;
+  double ambient;
+  FILE *trace;
+
+  // the relay can switch anywhere within a plant step (burst fire), so its on-time is integrated
+  uint8_t heaterLevel = LOW;
+  uint64_t heaterSince = 0;
+  uint64_t heaterOnUs = 0;
+  uint64_t faultHeaterOnUs = 0; // --sensor-error, after the detection
+
+  void onPinWrite(uint8_t pin, uint8_t level, void *)
+  {
+    if (pin != simPinRelayHeater || level == heaterLevel)
+      return;
+    uint64_t now = hal::nowMicros();
+    if (heaterLevel == HIGH)
+      heaterOnUs += now - heaterSince;
+    heaterLevel = level;
+    heaterSince = now;
+  }
+
+  float sensorTemperature(void *)
+  {
+    if (scenario.sensorErrorAt > 0 && hal::nowMicros() >= scenario.sensorErrorAt * 1e6)
+      return -127; // DEVICE_DISCONNECTED_C
+    return (float)model->sensor();
+  }
+
+  void zeroCross(void *)
+  {
+    hal::setDigitalInput(simPinZeroCross, HIGH);
+    hal::setDigitalInput(simPinZeroCross, LOW);
+  }
+
+  bool brewing(double t)
+  {
+    return scenario.brewAt > 0 && t >= scenario.brewAt && t < scenario.brewAt + scenario.brewTime;
+  }
+
+  void record(double t, double water)
+  {
+    double step = setPoint - ambient;
+    if (metrics.t10 < 0 && water >= ambient + 0.1 * step)
+      metrics.t10 = t;
+    if (metrics.t90 < 0 && water >= ambient + 0.9 * step)
+      metrics.t90 = t;
+
+    bool inside = fabs(water - setPoint) <= band;
+    bool beforeBrew = scenario.brewAt <= 0 || t < scenario.brewAt;
+    if (beforeBrew)
+    {
+      if (metrics.t90 >= 0)
+        metrics.overshoot = max(metrics.overshoot, water - setPoint);
+      if (!inside)
+        metrics.lastOutside = t;
+      metrics.settled = inside;
+      metrics.brewStartTemperature = water;
+      return;
+    }
+
+    double brewEnd = scenario.brewAt + scenario.brewTime;
+    metrics.brewMinimum = min(metrics.brewMinimum, water);
+    if (t >= brewEnd)
+    {
+      if (!inside)
+        metrics.lastOutsideAfterBrew = t;
+      metrics.recovered = inside;
+    }
+  }
+
+  void plantStep(void *)
+  {
+    uint64_t now = hal::nowMicros();
+    if (heaterLevel == HIGH)
+    {
+      heaterOnUs += now - heaterSince;
+      heaterSince = now;
+    }
+    double heater = (double)heaterOnUs / plantStepUs;
+    // 10 bad readings of 400 ms until sensorError, then one second of margin
+    if (scenario.sensorErrorAt > 0 && now >= (scenario.sensorErrorAt + 5) * 1e6)
+      faultHeaterOnUs += heaterOnUs;
+    heaterOnUs = 0;
+
+    double t = now / 1e6;
+    double flow = 0;
+    if (brewing(t))
+    {
+      // ONLYPID 0: the firmware runs the pump, the shot lasts as long as it keeps it on
+      flow = ONLYPID == 1 || hal::pinState(simPinRelayPumpe) == TRIGGERTYPE ? scenario.flow : 0;
+    }
+    hal::setAnalogInput(simAnalogPin, brewing(t) ? 4095 : 0); // brew switch
+
+    model->step(min(heater, 1.0), flow);
+    record(t, model->water());
+
+    if (stepApplied && now % 1000000 < plantStepUs)
+    {
+      stepResponse.push_back(Input);
+    }
+    if (trace && now % 1000000 < plantStepUs)
+    {
+      fprintf(trace, "%.0f,%.2f,%.2f,%.2f,%.1f\n", t, model->water(), model->body(), Input, Output);
+    }
+  }
+
+  double value(const char *text)
+  {
+    return atof(text);
+  }
+
+  /********************************************************
+    FOPDT fit of the open loop step response: the gain comes
+    from the final value, time constant and dead time from a
+    least squares fit of y0 + K u (1 - exp(-(t - L) / T))
+  ******************************************************/
+  void identifyModel()
+  {
+    const size_t tail = 60; // s averaged for the final value
+    if (stepResponse.size() < 4 * tail)
+    {
+      printf("identify: run too short\n");
+      return;
+    }
+    double start = stepResponse[0];
+    double end = 0;
+    for (size_t i = stepResponse.size() - tail; i < stepResponse.size(); i++)
+      end += stepResponse[i] / tail;
+    double rise = end - start;
+
+    double bestError = INFINITY, bestTime = 0, bestDead = 0;
+    for (double dead = 0; dead <= 30; dead += 0.5)
+    {
+      for (double time = 10; time <= 20000; time *= 1.02)
+      {
+        double error = 0;
+        for (size_t t = 0; t < stepResponse.size() && error < bestError; t++)
+        {
+          double model = t > dead ? start + rise * (1 - exp(-(t - dead) / time)) : start;
+          error += (stepResponse[t] - model) * (stepResponse[t] - model);
+        }
+        if (error < bestError)
+        {
+          bestError = error;
+          bestTime = time;
+          bestDead = dead;
+        }
+      }
+    }
+    printf("fopdt gain=%.4f time_constant_s=%.0f dead_time_s=%.1f\n", rise / scenario.identify, bestTime, bestDead);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  BoilerModelParameters parameters;
+  const char *traceFile = nullptr;
+  bool verbose = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *option = argv[i];
+    if (!strcmp(option, "--verbose"))
+    {
+      verbose = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      fprintf(stderr, "missing value for %s\n", option);
+      return 1;
+    }
+    const char *argument = argv[++i];
+    if (!strcmp(option, "--kp"))
+      aggKp = value(argument);
+    else if (!strcmp(option, "--tn"))
+      aggTn = value(argument);
+    else if (!strcmp(option, "--tv"))
+      aggTv = value(argument);
+    else if (!strcmp(option, "--start-kp"))
+      startKp = value(argument);
+    else if (!strcmp(option, "--start-tn"))
+      startTn = value(argument);
+    else if (!strcmp(option, "--brew-kp"))
+      aggbKp = value(argument);
+    else if (!strcmp(option, "--brew-tn"))
+      aggbTn = value(argument);
+    else if (!strcmp(option, "--brew-tv"))
+      aggbTv = value(argument);
+    else if (!strcmp(option, "--setpoint"))
+      setPoint = value(argument);
+    else if (!strcmp(option, "--brew-at"))
+      scenario.brewAt = value(argument);
+    else if (!strcmp(option, "--brew-time"))
+      scenario.brewTime = value(argument);
+    else if (!strcmp(option, "--flow"))
+      scenario.flow = value(argument);
+    else if (!strcmp(option, "--controller"))
+      controller = atoi(argument);
+    else if (!strcmp(option, "--model"))
+    {
+      float gain, timeConstant, deadTime;
+      if (sscanf(argument, "%f:%f:%f", &gain, &timeConstant, &deadTime) != 3)
+      {
+        fprintf(stderr, "--model needs gain:time constant:dead time\n");
+        return 1;
+      }
+      smithPredictor = SmithPredictor(gain, timeConstant, deadTime, HEATERWINDOW / 1000.0f);
+    }
+    else if (!strcmp(option, "--boost"))
+      brewBoostON = atoi(argument);
+    else if (!strcmp(option, "--seconds"))
+      scenario.seconds = value(argument);
+    else if (!strcmp(option, "--loop-us"))
+      scenario.loopUs = strtoul(argument, nullptr, 10);
+    else if (!strcmp(option, "--heater-w"))
+      parameters.heaterPower = value(argument);
+    else if (!strcmp(option, "--dead-time"))
+      parameters.sensorDeadTime = value(argument);
+    else if (!strcmp(option, "--sensor-lag"))
+      parameters.sensorTimeConstant = value(argument);
+    else if (!strcmp(option, "--noise"))
+      parameters.sensorNoise = value(argument);
+    else if (!strcmp(option, "--seed"))
+      parameters.seed = strtoul(argument, nullptr, 10);
+    else if (!strcmp(option, "--autotune"))
+      scenario.autotuneAt = value(argument);
+    else if (!strcmp(option, "--sensor-error"))
+      scenario.sensorErrorAt = value(argument);
+    else if (!strcmp(option, "--identify"))
+      scenario.identify = value(argument);
+    else if (!strcmp(option, "--trace"))
+      traceFile = argument;
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", option);
+      return 1;
+    }
+  }
+
+  BoilerModel boiler(parameters, plantStepUs / 1e6);
+  model = &boiler;
+  ambient = parameters.ambient;
+  if (traceFile)
+  {
+    trace = fopen(traceFile, "w");
+    if (!trace)
+    {
+      perror(traceFile);
+      return 1;
+    }
+    fprintf(trace, "t,water,body,input,output\n");
+  }
+
+  hal::setRealtime(false);
+  hal::setSerialEnabled(verbose);
+  hal::setTemperatureSource(sensorTemperature, nullptr);
+  hal::onPinWrite(onPinWrite, nullptr);
+  hal::addPeriodic(plantStepUs, 0, plantStep, nullptr);
+  if (HEATERMODE == 1)
+  {
+    hal::addPeriodic(halfWaveUs, 0, zeroCross, nullptr);
+  }
+
+  Offlinemodus = 1; // parameters above are final, no Blynk sync or EEPROM
+  setup();
+  uint64_t end = (uint64_t)(scenario.seconds * 1e6);
+  uint64_t autotuneAt = scenario.autotuneAt > 0 ? (uint64_t)(scenario.autotuneAt * 1e6) : UINT64_MAX;
+  while (hal::nowMicros() < end)
+  {
+    if (hal::nowMicros() >= autotuneAt)
+    {
+      startAutotune(); // like Blynk V41
+      autotuneAt = UINT64_MAX;
+    }
+    if (scenario.identify > 0)
+    {
+      pidON = 0; // loop() switches to MANUAL, then the step is requested
+      if (pidMode == 0 && !stepApplied)
+      {
+        setManualOutput(scenario.identify);
+        stepApplied = true;
+      }
+    }
+    loop();
+    hal::advance(scenario.loopUs);
+  }
+  if (scenario.identify > 0)
+  {
+    identifyModel();
+    return 0;
+  }
+
+  double rise = metrics.t10 >= 0 && metrics.t90 >= 0 ? metrics.t90 - metrics.t10 : -1;
+  double settle = metrics.settled ? metrics.lastOutside + plantStepUs / 1e6 : -1;
+  double brewEnd = scenario.brewAt + scenario.brewTime;
+  bool shot = scenario.brewAt > 0 && scenario.brewAt < scenario.seconds;
+  double brewDrop = shot ? metrics.brewStartTemperature - metrics.brewMinimum : -1;
+  double recovery = shot && metrics.recovered ? max(0.0, metrics.lastOutsideAfterBrew - brewEnd) : -1;
+  printf("rise_s=%.1f overshoot_c=%.2f settle_s=%.1f brew_drop_c=%.2f recovery_s=%.1f\n",
+         rise, metrics.overshoot, settle, brewDrop, recovery);
+  if (scenario.autotuneAt > 0)
+  {
+    static const char *states[] = {"aborted", "running", "done", "failed"};
+    printf("autotune=%s ku=%.1f pu_s=%.1f kp=%.1f tn=%.1f tv=%.1f\n", states[autotune.state()],
+           autotune.ultimateGain(), autotune.ultimatePeriod(), aggKp, aggTn, aggTv);
+  }
+  if (scenario.sensorErrorAt > 0)
+  {
+    printf("sensor_error heater_on_s=%.2f output=%.1f\n", faultHeaterOnUs / 1e6, Output);
+  }
+
+  if (trace)
+    fclose(trace);
+  return scenario.sensorErrorAt > 0 && (faultHeaterOnUs > 0 || Output != 0) ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+/********************************************************
+  ThreadPool - work stealing pool for the tuner
+  Every worker owns a deque: it takes new work from the back
+  of its own deque and steals from the front of the others
+  when it runs dry. Jobs submitted from inside a job go to
+  the submitting worker, so a search step that fans out is
+  first worked on locally and only spread when cores idle.
+******************************************************/
+
+#ifndef _threadPool_H
+#define _threadPool_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+  typedef std::function<void()> Job;
+
+  explicit ThreadPool(unsigned threads)
+  {
+    if (threads == 0)
+    {
+      threads = 1;
+    }
+    for (unsigned i = 0; i < threads; i++)
+    {
+      workers.emplace_back(new Worker);
+    }
+    for (unsigned i = 0; i < threads; i++)
+    {
+      this->threads.emplace_back(&ThreadPool::run, this, i);
+    }
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> guard(idleLock);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  unsigned size() const { return workers.size(); }
+
+  void submit(Job job)
+  {
+    int self = current();
+    unsigned target = self >= 0 ? self : next++ % workers.size();
+    pending++;
+    {
+      std::lock_guard<std::mutex> guard(workers[target]->lock);
+      workers[target]->jobs.push_back(std::move(job));
+    }
+    {
+      std::lock_guard<std::mutex> guard(idleLock);
+      queued++;
+    }
+    wake.notify_one();
+  }
+
+  // until every submitted job (and what it submitted) is done, not from inside a job
+  void wait()
+  {
+    std::unique_lock<std::mutex> guard(idleLock);
+    done.wait(guard, [this] { return pending == 0; });
+  }
+
+private:
+  struct Worker
+  {
+    std::mutex lock;
+    std::deque<Job> jobs;
+  };
+
+  static int &current()
+  {
+    static thread_local int index = -1;
+    return index;
+  }
+
+  bool take(unsigned self, Job &job)
+  {
+    for (unsigned i = 0; i < workers.size(); i++)
+    {
+      Worker &worker = *workers[(self + i) % workers.size()];
+      std::lock_guard<std::mutex> guard(worker.lock);
+      if (worker.jobs.empty())
+      {
+        continue;
+      }
+      if (i == 0)
+      {
+        job = std::move(worker.jobs.back());
+        worker.jobs.pop_back();
+      }
+      else
+      {
+        job = std::move(worker.jobs.front());
+        worker.jobs.pop_front();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void run(unsigned self)
+  {
+    current() = self;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> guard(idleLock);
+        wake.wait(guard, [this] { return stopping || queued > 0; });
+        if (queued == 0)
+        {
+          return;
+        }
+        queued--;
+      }
+      // a job is pushed before it is counted, so the reservation has one in some deque,
+      // but a thief may take the one of a deque this scan already passed: scan again
+      Job job;
+      while (!take(self, job))
+      {
+        std::this_thread::yield();
+      }
+      job();
+      if (--pending == 0)
+      {
+        std::lock_guard<std::mutex> guard(idleLock);
+        done.notify_all();
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+  std::mutex idleLock;
+  std::condition_variable wake;
+  std::condition_variable done;
+  unsigned queued = 0; // jobs in any deque, guarded by idleLock
+  std::atomic<unsigned> pending{0};
+  std::atomic<unsigned> next{0};
+  bool stopping = false;
+};
+
+#endif // _threadPool_H
@@ -0,0 +1,505 @@
+/********************************************************
+  PID tuner - searches the tunings with the boiler simulator
+  A grid over the parameter ranges, then Nelder-Mead starting
+  at the knee of the Pareto front. Every evaluation is one run
+  of the sim program (the firmware globals allow one machine
+  per process), the runs are spread over a work stealing pool
+  with one worker per core. Build the sim env first, then
+  "pio run -e tuner" and call .pio/build/tuner/program:
+    --kp LOW:HIGH:STEPS         range of AGGKP, a single value fixes it
+    --tn, --tv                  AGGTN, AGGTV
+    --brew-kp, --brew-tn, --brew-tv   AGGBKP, AGGBTN, AGGBTV
+    --start-kp, --start-tn      STARTKP, STARTTN, fixed unless a range is given
+    --refine N                  Nelder-Mead iterations, default 30, 0 = grid only
+    --jobs N                    parallel runs, default one per core
+    --sim PATH                  default .pio/build/sim/program
+    -- ...                      everything after is passed to each sim run
+  Prints the Pareto front of settle time, overshoot and brew
+  temperature drop and a userConfig.h block for its knee.
+******************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <mutex>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "threadPool.h"
+
+extern char **environ;
+
+namespace
+{
+  struct Parameter
+  {
+    const char *option;  // option of the tuner and of the sim
+    const char *define;  // name in userConfig.h
+    const char *comment; // comment in userConfig.h
+    double low, high;
+    int steps;
+  };
+
+  Parameter parameters[] = {
+      {"--kp", "AGGKP", "Kp", 30, 120, 4},
+      {"--tn", "AGGTN", "Tn", 150, 600, 4},
+      {"--tv", "AGGTV", "Tv", 0, 40, 3},
+      {"--brew-kp", "AGGBKP", "Kp", 30, 150, 3},
+      {"--brew-tn", "AGGBTN", "Tn", 0, 0, 1},
+      {"--brew-tv", "AGGBTV", "Tv", 0, 40, 3},
+      {"--start-kp", "STARTKP", "Start Kp during coldstart", 50, 50, 1},
+      {"--start-tn", "STARTTN", "Start Tn during cold start", 150, 150, 1},
+  };
+  const int parameterCount = sizeof(parameters) / sizeof(parameters[0]);
+
+  struct Result
+  {
+    double values[parameterCount];
+    double settle, overshoot, brewDrop, recovery;
+    bool valid; // settled before the shot and recovered after it
+  };
+
+  const char *simPath = ".pio/build/sim/program";
+  std::vector<const char *> simArguments;
+  std::vector<Result> results;
+  std::mutex resultsLock;
+
+  Result simulate(const double values[])
+  {
+    Result result = Result();
+    std::copy(values, values + parameterCount, result.values);
+
+    std::vector<std::string> texts;
+    for (int i = 0; i < parameterCount; i++)
+    {
+      char text[32];
+      snprintf(text, sizeof(text), "%g", values[i]);
+      texts.push_back(parameters[i].option);
+      texts.push_back(text);
+    }
+    std::vector<char *> argv;
+    argv.push_back((char *)simPath);
+    for (std::string &text : texts)
+    {
+      argv.push_back(&text[0]);
+    }
+    for (const char *argument : simArguments)
+    {
+      argv.push_back((char *)argument);
+    }
+    argv.push_back(nullptr);
+
+    // close-on-exec, other workers spawn at the same time and must not inherit the write end
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+    {
+      perror("pipe");
+      return result;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    pid_t pid;
+    int error = posix_spawn(&pid, simPath, &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (error != 0)
+    {
+      fprintf(stderr, "%s: %s\n", simPath, strerror(error));
+      close(fds[0]);
+      return result;
+    }
+
+    std::string output;
+    char buffer[256];
+    ssize_t length;
+    while ((length = read(fds[0], buffer, sizeof(buffer))) > 0)
+    {
+      output.append(buffer, length);
+    }
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+
+    double rise;
+    if (sscanf(output.c_str(), "rise_s=%lf overshoot_c=%lf settle_s=%lf brew_drop_c=%lf recovery_s=%lf", &rise,
+               &result.overshoot, &result.settle, &result.brewDrop, &result.recovery) == 5)
+    {
+      result.valid = result.settle >= 0 && result.recovery >= 0;
+    }
+    return result;
+  }
+
+  // runs all points in parallel, keeps every result for the Pareto front
+  std::vector<Result> evaluate(ThreadPool &pool, const std::vector<std::vector<double>> &points)
+  {
+    std::vector<Result> batch(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+      pool.submit([&, i] { batch[i] = simulate(points[i].data()); });
+    }
+    pool.wait();
+    std::lock_guard<std::mutex> guard(resultsLock);
+    results.insert(results.end(), batch.begin(), batch.end());
+    return batch;
+  }
+
+  bool dominates(const Result &a, const Result &b)
+  {
+    bool noWorse = a.settle <= b.settle && a.overshoot <= b.overshoot && a.brewDrop <= b.brewDrop;
+    bool better = a.settle < b.settle || a.overshoot < b.overshoot || a.brewDrop < b.brewDrop;
+    return noWorse && better;
+  }
+
+  std::vector<Result> paretoFront()
+  {
+    std::vector<Result> front;
+    for (const Result &candidate : results)
+    {
+      if (!candidate.valid)
+        continue;
+      bool dominated = false;
+      for (const Result &other : results)
+      {
+        if (other.valid && dominates(other, candidate))
+        {
+          dominated = true;
+          break;
+        }
+      }
+      if (!dominated)
+        front.push_back(candidate);
+    }
+    std::sort(front.begin(), front.end(), [](const Result &a, const Result &b) { return a.settle < b.settle; });
+    return front;
+  }
+
+  // every objective scaled to 0 ... 1 over the grid, the knee of the front is closest to the origin
+  struct Scale
+  {
+    double settle[2], overshoot[2], brewDrop[2];
+
+    explicit Scale(const std::vector<Result> &runs)
+    {
+      settle[0] = overshoot[0] = brewDrop[0] = INFINITY;
+      settle[1] = overshoot[1] = brewDrop[1] = -INFINITY;
+      for (const Result &result : runs)
+      {
+        if (!result.valid)
+          continue;
+        include(settle, result.settle);
+        include(overshoot, result.overshoot);
+        include(brewDrop, result.brewDrop);
+      }
+    }
+
+    static void include(double range[2], double value)
+    {
+      range[0] = std::min(range[0], value);
+      range[1] = std::max(range[1], value);
+    }
+
+    static double normalize(const double range[2], double value)
+    {
+      double span = range[1] - range[0];
+      return span > 0 ? (value - range[0]) / span : 0;
+    }
+
+    double cost(const Result &result) const
+    {
+      if (!result.valid)
+        return INFINITY;
+      double s = normalize(settle, result.settle);
+      double o = normalize(overshoot, result.overshoot);
+      double b = normalize(brewDrop, result.brewDrop);
+      return sqrt(s * s + o * o + b * b);
+    }
+  };
+
+  const Result *kneeOf(const std::vector<Result> &front, const Scale &scale)
+  {
+    const Result *knee = &front[0];
+    for (const Result &result : front)
+    {
+      if (scale.cost(result) < scale.cost(*knee))
+        knee = &result;
+    }
+    return knee;
+  }
+
+  void grid(ThreadPool &pool)
+  {
+    std::vector<std::vector<double>> points(1, std::vector<double>());
+    for (const Parameter &parameter : parameters)
+    {
+      std::vector<std::vector<double>> expanded;
+      for (const std::vector<double> &point : points)
+      {
+        for (int step = 0; step < parameter.steps; step++)
+        {
+          double value = parameter.steps > 1
+                             ? parameter.low + (parameter.high - parameter.low) * step / (parameter.steps - 1)
+                             : parameter.low;
+          expanded.push_back(point);
+          expanded.back().push_back(value);
+        }
+      }
+      points.swap(expanded);
+    }
+    fprintf(stderr, "grid: %zu runs on %u workers\n", points.size(), pool.size());
+    evaluate(pool, points);
+  }
+
+  /********************************************************
+    Nelder-Mead over the parameters with a range. Reflection,
+    expansion and both contractions are run speculatively in
+    one batch, a shrink runs all new vertices in one batch.
+  ******************************************************/
+  void refine(ThreadPool &pool, const Result &start, const Scale &scale, int iterations)
+  {
+    std::vector<int> free;
+    for (int i = 0; i < parameterCount; i++)
+    {
+      if (parameters[i].steps > 1 && parameters[i].high > parameters[i].low)
+        free.push_back(i);
+    }
+    if (free.empty() || iterations <= 0)
+      return;
+
+    // keeps a vertex in the ranges given on the command line, negative tunings make no sense
+    auto clamp = [&](std::vector<double> &x) {
+      for (size_t j = 0; j < free.size(); j++)
+      {
+        const Parameter &parameter = parameters[free[j]];
+        x[j] = std::min(std::max(x[j], std::max(0.0, parameter.low)), parameter.high);
+      }
+    };
+    // values of a clamped vertex
+    auto point = [&](const std::vector<double> &x) {
+      std::vector<double> values(start.values, start.values + parameterCount);
+      for (size_t j = 0; j < free.size(); j++)
+        values[free[j]] = x[j];
+      return values;
+    };
+
+    size_t n = free.size();
+    std::vector<std::vector<double>> simplex(n + 1, std::vector<double>(n));
+    for (size_t j = 0; j < n; j++)
+      simplex[0][j] = start.values[free[j]];
+    for (size_t i = 1; i <= n; i++)
+    {
+      simplex[i] = simplex[0];
+      const Parameter &parameter = parameters[free[i - 1]];
+      double step = 0.1 * (parameter.high - parameter.low);
+      simplex[i][i - 1] += simplex[0][i - 1] + step <= parameter.high ? step : -step; // into the range
+      clamp(simplex[i]);
+    }
+
+    std::vector<double> costs(n + 1);
+    costs[0] = scale.cost(start);
+    std::vector<std::vector<double>> batch;
+    for (size_t i = 1; i <= n; i++)
+      batch.push_back(point(simplex[i]));
+    std::vector<Result> evaluated = evaluate(pool, batch);
+    for (size_t i = 1; i <= n; i++)
+      costs[i] = scale.cost(evaluated[i - 1]);
+
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+      std::vector<size_t> order(n + 1);
+      for (size_t i = 0; i <= n; i++)
+        order[i] = i;
+      std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return costs[a] < costs[b]; });
+      size_t best = order[0], secondWorst = order[n - 1], worst = order[n];
+
+      std::vector<double> centroid(n, 0);
+      for (size_t i = 0; i <= n; i++)
+      {
+        if (i == worst)
+          continue;
+        for (size_t j = 0; j < n; j++)
+          centroid[j] += simplex[i][j] / n;
+      }
+      auto along = [&](double factor) {
+        std::vector<double> x(n);
+        for (size_t j = 0; j < n; j++)
+          x[j] = centroid[j] + factor * (centroid[j] - simplex[worst][j]);
+        return x;
+      };
+      std::vector<std::vector<double>> candidates = {along(1), along(2), along(0.5), along(-0.5)};
+      batch.clear();
+      for (std::vector<double> &x : candidates)
+      {
+        clamp(x); // the simplex keeps the vertex that was evaluated
+        batch.push_back(point(x));
+      }
+      evaluated = evaluate(pool, batch);
+      double reflected = scale.cost(evaluated[0]), expanded = scale.cost(evaluated[1]);
+      double outside = scale.cost(evaluated[2]), inside = scale.cost(evaluated[3]);
+
+      int accept = -1;
+      if (reflected < costs[best])
+        accept = expanded < reflected ? 1 : 0;
+      else if (reflected < costs[secondWorst])
+        accept = 0;
+      else if (reflected < costs[worst] && outside <= reflected)
+        accept = 2;
+      else if (reflected >= costs[worst] && inside < costs[worst])
+        accept = 3;
+
+      if (accept >= 0)
+      {
+        simplex[worst] = candidates[accept];
+        costs[worst] = scale.cost(evaluated[accept]);
+        continue;
+      }
+
+      // shrink towards the best vertex
+      batch.clear();
+      std::vector<size_t> moved;
+      for (size_t i = 0; i <= n; i++)
+      {
+        if (i == best)
+          continue;
+        for (size_t j = 0; j < n; j++)
+          simplex[i][j] = simplex[best][j] + 0.5 * (simplex[i][j] - simplex[best][j]);
+        clamp(simplex[i]);
+        batch.push_back(point(simplex[i]));
+        moved.push_back(i);
+      }
+      evaluated = evaluate(pool, batch);
+      for (size_t k = 0; k < moved.size(); k++)
+        costs[moved[k]] = scale.cost(evaluated[k]);
+    }
+  }
+
+  bool parseRange(Parameter &parameter, const char *text)
+  {
+    double low, high;
+    int steps;
+    if (sscanf(text, "%lf:%lf:%d", &low, &high, &steps) == 3 && steps >= 1)
+    {
+      parameter.low = low;
+      parameter.high = high;
+      parameter.steps = steps;
+      return true;
+    }
+    if (sscanf(text, "%lf", &low) == 1)
+    {
+      parameter.low = parameter.high = low;
+      parameter.steps = 1;
+      return true;
+    }
+    return false;
+  }
+
+  double rounded(double value)
+  {
+    return round(value * 10) / 10;
+  }
+
+  void printDefine(const Result &result, const char *define)
+  {
+    for (int i = 0; i < parameterCount; i++)
+    {
+      if (!strcmp(parameters[i].define, define))
+        printf("#define %s %g    // %s\n", define, rounded(result.values[i]), parameters[i].comment);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned jobs = std::thread::hardware_concurrency();
+  int iterations = 30;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--"))
+    {
+      simArguments.assign(argv + i + 1, argv + argc);
+      break;
+    }
+    if (i + 1 >= argc)
+    {
+      fprintf(stderr, "missing value for %s\n", argv[i]);
+      return 1;
+    }
+    const char *option = argv[i];
+    const char *argument = argv[++i];
+    bool known = true;
+    if (!strcmp(option, "--jobs"))
+      jobs = strtoul(argument, nullptr, 10);
+    else if (!strcmp(option, "--refine"))
+      iterations = atoi(argument);
+    else if (!strcmp(option, "--sim"))
+      simPath = argument;
+    else
+    {
+      known = false;
+      for (Parameter &parameter : parameters)
+      {
+        if (!strcmp(option, parameter.option))
+          known = parseRange(parameter, argument);
+      }
+    }
+    if (!known)
+    {
+      fprintf(stderr, "bad option %s %s\n", option, argument);
+      return 1;
+    }
+  }
+  if (access(simPath, X_OK) != 0)
+  {
+    fprintf(stderr, "%s not found, build it with \"pio run -e sim\" or pass --sim\n", simPath);
+    return 1;
+  }
+
+  ThreadPool pool(jobs);
+  grid(pool);
+  std::vector<Result> front = paretoFront();
+  if (front.empty())
+  {
+    fprintf(stderr, "no run settled before the shot and recovered after it, widen the ranges or lengthen the scenario\n");
+    return 1;
+  }
+  Scale scale(results);
+  refine(pool, *kneeOf(front, scale), scale, iterations);
+  fprintf(stderr, "%zu runs in total\n", results.size());
+
+  front = paretoFront();
+  const Result *knee = kneeOf(front, scale);
+
+  printf("Pareto front (%zu of %zu runs)\n", front.size(), results.size());
+  printf("settle_s overshoot_c brew_drop_c recovery_s");
+  for (const Parameter &parameter : parameters)
+    printf(" %s", parameter.define);
+  printf("\n");
+  for (const Result &result : front)
+  {
+    printf("%8.1f %11.2f %11.2f %10.1f", result.settle, result.overshoot, result.brewDrop, result.recovery);
+    for (int i = 0; i < parameterCount; i++)
+      printf(" %g", rounded(result.values[i]));
+    printf("%s\n", &result == knee ? "  <- knee" : "");
+  }
+
+  printf("\n// tools/tuner: settle %.0f s, overshoot %.2f C, brew drop %.2f C, recovery %.0f s\n", knee->settle,
+         knee->overshoot, knee->brewDrop, knee->recovery);
+  printf("//PID - values for offline brewdetection\n");
+  printDefine(*knee, "AGGBKP");
+  printDefine(*knee, "AGGBTN");
+  printDefine(*knee, "AGGBTV");
+  printf("\n//PID - offline values\n");
+  printDefine(*knee, "AGGKP");
+  printDefine(*knee, "AGGTN");
+  printDefine(*knee, "AGGTV");
+  printDefine(*knee, "STARTKP");
+  printDefine(*knee, "STARTTN");
+  return 0;
+}